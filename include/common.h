@@ -5,14 +5,11 @@
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <learnopengl/vfs.h>
 
+// the file at path, empty if it can't be found
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    return VirtualFileSystem::shared().open(path).str();
 }
 
 
@@ -0,0 +1,400 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/lz4.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// bump whenever the layout of the archive changes
+const uint32_t ARCHIVE_VERSION = 1;
+const char ARCHIVE_MAGIC[8] = "LOGLPAK";
+// blobs start on page boundaries, so views of stored entries are page aligned and no two entries share a page
+const size_t ARCHIVE_ALIGNMENT = 4096;
+// an entry is only stored compressed when LZ4 saves at least this fraction of it, decompressing costs a copy
+const double ARCHIVE_MIN_SAVING = 0.1;
+
+enum ArchiveEntryFlags {
+    ARCHIVE_ENTRY_LZ4 = 1
+};
+
+// Packed asset archive, written by tools/pack_assets.cpp. Layout:
+//
+//   ArchiveHeader
+//   ArchiveEntry[entryCount], sorted by path
+//   path strings, pathBytes of them
+//   blobs, each at a multiple of ARCHIVE_ALIGNMENT, in the order the files were packed
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t pathBytes;
+};
+
+struct ArchiveEntry {
+    uint64_t offset;      // of the blob, from the start of the archive
+    uint64_t storedSize;  // of the blob, compressed or not
+    uint64_t size;        // of the file
+    uint64_t hash;        // hashBytes of the file, so caches can key on it without reading the file
+    uint32_t pathOffset, pathLength;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+// Read only bytes of a file, kept alive by whatever holds them: a mapping of the file itself or of the archive it was
+// packed into, or the buffer it was decompressed into. cheap to copy, copies share the bytes
+class FileView
+{
+public:
+    FileView() = default;
+
+    FileView(shared_ptr<const void> owner, const unsigned char *data, size_t size)
+        : owner(move(owner)), bytes(data), length(size), present(true)
+    {
+    }
+
+    static FileView fromBuffer(vector<unsigned char> buffer)
+    {
+        shared_ptr<vector<unsigned char>> owned = make_shared<vector<unsigned char>>(move(buffer));
+        return FileView(owned, owned->data(), owned->size());
+    }
+
+    // false when the file wasn't found, an empty file is valid
+    bool valid() const
+    {
+        return present;
+    }
+
+    const unsigned char *data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    // size bytes from offset, sharing the owner
+    FileView slice(size_t offset, size_t size) const
+    {
+        return FileView(owner, bytes + offset, size);
+    }
+
+    string str() const
+    {
+        return length ? string((const char *)bytes, length) : string();
+    }
+
+private:
+    shared_ptr<const void> owner;
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+    bool present = false;
+};
+
+namespace archive_detail {
+
+struct Mapping {
+    void *address;
+    size_t size;
+
+    ~Mapping()
+    {
+        munmap(address, size);
+    }
+};
+
+} // namespace archive_detail
+
+// the whole file at path as a view of a private read only mapping, pages are read as they are touched.
+// an invalid view if it isn't a regular file that can be opened
+FileView mapFile(const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return FileView();
+    FileView view;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        // mmap refuses empty files
+        if (st.st_size == 0)
+            view = FileView::fromBuffer(vector<unsigned char>());
+        else
+        {
+            void *address = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                shared_ptr<archive_detail::Mapping> mapping(new archive_detail::Mapping{address, (size_t)st.st_size});
+                view = FileView(mapping, (const unsigned char *)address, mapping->size);
+            }
+        }
+    }
+    close(fd);
+    return view;
+}
+
+// the path an archive stores a file under: forward slashes, no empty, . or .. components (.. at the start of a
+// relative path are kept)
+string normalizeArchivePath(const string &path)
+{
+    bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+    vector<string> parts;
+    size_t start = 0;
+    while (start <= path.size())
+    {
+        size_t end = path.find_first_of("/\\", start);
+        if (end == string::npos)
+            end = path.size();
+        string part = path.substr(start, end - start);
+        if (part == "..")
+        {
+            if (!parts.empty() && parts.back() != "..")
+                parts.pop_back();
+            else if (!absolute)
+                parts.push_back(part);
+        }
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        start = end + 1;
+    }
+    string normalized = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); i++)
+        normalized += (i ? "/" : "") + parts[i];
+    return normalized;
+}
+
+// A packed archive mapped into memory. entries stored as they are come back as views straight into the mapping,
+// nothing is copied; compressed ones are decompressed into a buffer of their own. lookups are a binary search
+// over the index, safe from any thread once open returned
+class Archive
+{
+public:
+    bool open(const string &path)
+    {
+        archivePath = path;
+        file = mapFile(path);
+        if (!file.valid())
+            return false;
+        const unsigned char *base = file.data();
+        size_t size = file.size();
+        if (size < sizeof(ArchiveHeader))
+            return invalid();
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ARCHIVE_VERSION)
+            return invalid();
+        size_t pathsStart = sizeof(ArchiveHeader) + (size_t)header.entryCount * sizeof(ArchiveEntry);
+        if (pathsStart > size || header.pathBytes > size - pathsStart)
+            return invalid();
+        // the header keeps the index 8 byte aligned in the page aligned mapping
+        entries = (const ArchiveEntry *)(base + sizeof(ArchiveHeader));
+        paths = (const char *)(base + pathsStart);
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            const ArchiveEntry &entry = entries[i];
+            if ((uint64_t)entry.pathOffset + entry.pathLength > header.pathBytes || entry.offset > size
+                || entry.storedSize > size - entry.offset || (!(entry.flags & ARCHIVE_ENTRY_LZ4) && entry.storedSize != entry.size))
+                return invalid();
+        }
+        return true;
+    }
+
+    // entry stored under path, which must already be normalized. nullptr if there is none
+    const ArchiveEntry *find(const string &path) const
+    {
+        const ArchiveEntry *end = entries + header.entryCount;
+        const ArchiveEntry *found = lower_bound(entries, end, path, [&](const ArchiveEntry &entry, const string &name) {
+            return entryPath(entry).compare(name) < 0;
+        });
+        return found != end && entryPath(*found) == path ? found : nullptr;
+    }
+
+    // the file of an entry. asks the kernel to read the whole blob ahead, so a loader walking through it doesn't stall
+    // on a page fault (and a seek) at a time
+    FileView view(const ArchiveEntry &entry) const
+    {
+        if (entry.storedSize > 0)
+        {
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            size_t start = (size_t)entry.offset / page * page;
+            madvise((void *)(file.data() + start), (size_t)(entry.offset + entry.storedSize) - start, MADV_WILLNEED);
+        }
+        FileView blob = file.slice((size_t)entry.offset, (size_t)entry.storedSize);
+        if (!(entry.flags & ARCHIVE_ENTRY_LZ4))
+            return blob;
+        vector<unsigned char> contents((size_t)entry.size);
+        if (!lz4Decompress(blob.data(), blob.size(), contents.data(), contents.size()))
+        {
+            cout << "ERROR::ARCHIVE::CORRUPT_ENTRY: " << entryPath(entry).str() << " in " << archivePath << endl;
+            return FileView();
+        }
+        return FileView::fromBuffer(move(contents));
+    }
+
+    size_t size() const
+    {
+        return header.entryCount;
+    }
+
+    const string &path() const
+    {
+        return archivePath;
+    }
+
+private:
+    // a view of a path string in the index, compared without copying it
+    struct PathView {
+        const char *data;
+        size_t size;
+
+        int compare(const string &other) const
+        {
+            int result = memcmp(data, other.data(), min(size, other.size()));
+            return result != 0 ? result : (size < other.size() ? -1 : size > other.size() ? 1 : 0);
+        }
+
+        bool operator==(const string &other) const
+        {
+            return compare(other) == 0;
+        }
+
+        string str() const
+        {
+            return string(data, size);
+        }
+    };
+
+    string archivePath;
+    FileView file;
+    ArchiveHeader header = {};
+    const ArchiveEntry *entries = nullptr;
+    const char *paths = nullptr;
+
+    PathView entryPath(const ArchiveEntry &entry) const
+    {
+        return PathView{paths + entry.pathOffset, entry.pathLength};
+    }
+
+    bool invalid()
+    {
+        cout << "ERROR::ARCHIVE::INVALID_ARCHIVE: " << archivePath << endl;
+        file = FileView();
+        header = ArchiveHeader();
+        return false;
+    }
+};
+
+// a file to pack, path as it will be looked up (see normalizeArchivePath)
+struct ArchiveInput {
+    string path;
+    FileView contents;
+};
+
+struct ArchiveStats {
+    size_t files = 0;
+    size_t compressed = 0;
+    uint64_t bytes = 0;        // of the files
+    uint64_t storedBytes = 0;  // of their blobs
+};
+
+// writes the files into a new archive at path, the blobs in the order of files, so files that are loaded together
+// should be next to each other. with compress set, entries LZ4 shrinks by ARCHIVE_MIN_SAVING are stored compressed
+bool writeArchive(const string &path, const vector<ArchiveInput> &files, bool compress, ArchiveStats &stats)
+{
+    vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a].path < files[b].path; });
+    for (size_t i = 1; i < order.size(); i++)
+        if (files[order[i]].path == files[order[i - 1]].path)
+        {
+            cout << "ERROR::ARCHIVE::DUPLICATE_PATH: " << files[order[i]].path << endl;
+            return false;
+        }
+
+    auto align = [](uint64_t offset) { return (offset + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT; };
+    ArchiveHeader header = {};
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = (uint32_t)files.size();
+    vector<ArchiveEntry> entries(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        entries[i].pathOffset = (uint32_t)header.pathBytes;
+        entries[i].pathLength = (uint32_t)files[i].path.size();
+        header.pathBytes += files[i].path.size();
+    }
+
+    vector<vector<unsigned char>> compressed(files.size());
+    uint64_t offset = align(sizeof(ArchiveHeader) + files.size() * sizeof(ArchiveEntry) + header.pathBytes);
+    stats = ArchiveStats();
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const FileView &contents = files[i].contents;
+        ArchiveEntry &entry = entries[i];
+        entry.size = contents.size();
+        entry.storedSize = contents.size();
+        entry.hash = hashBytes(contents.data(), contents.size());
+        if (compress && contents.size() > 0)
+        {
+            lz4Compress(contents.data(), contents.size(), compressed[i]);
+            if (compressed[i].size() <= contents.size() * (1.0 - ARCHIVE_MIN_SAVING))
+            {
+                entry.flags |= ARCHIVE_ENTRY_LZ4;
+                entry.storedSize = compressed[i].size();
+                stats.compressed++;
+            }
+            else
+                compressed[i] = vector<unsigned char>();
+        }
+        // empty files take no space, their offset only has to be in the archive
+        if (entry.storedSize > 0)
+        {
+            entry.offset = offset;
+            offset = align(offset + entry.storedSize);
+        }
+        stats.files++;
+        stats.bytes += entry.size;
+        stats.storedBytes += entry.storedSize;
+    }
+
+    FILE *out = fopen(path.c_str(), "wb");
+    if (!out)
+    {
+        cout << "ERROR::ARCHIVE::CANNOT_WRITE: " << path << endl;
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (size_t i : order)
+        written = written && fwrite(&entries[i], sizeof(ArchiveEntry), 1, out) == 1;
+    for (const ArchiveInput &input : files)
+        written = written && fwrite(input.path.data(), 1, input.path.size(), out) == input.path.size();
+    for (size_t i = 0; i < files.size() && written; i++)
+    {
+        const unsigned char *blob = entries[i].flags & ARCHIVE_ENTRY_LZ4 ? compressed[i].data() : files[i].contents.data();
+        written = fseek(out, (long)entries[i].offset, SEEK_SET) == 0
+                  && fwrite(blob, 1, (size_t)entries[i].storedSize, out) == entries[i].storedSize;
+    }
+    written = fclose(out) == 0 && written;
+    if (!written)
+    {
+        cout << "ERROR::ARCHIVE::CANNOT_WRITE: " << path << endl;
+        remove(path.c_str());
+    }
+    return written;
+}
+#endif
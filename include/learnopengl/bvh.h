@@ -0,0 +1,390 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <learnopengl/frustum.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+using namespace std;
+
+// bins per axis tried by the SAH build
+const int BVH_BINS = 12;
+// relative cost of visiting a node against testing a primitive
+const float BVH_TRAVERSAL_COST = 1.0f;
+// nodes this deep become leaves whatever their size, so the traversal stacks (a node pops one entry and pushes at
+// most two, which keeps them at depth + 1 entries) never fill up
+const int BVH_MAX_DEPTH = 63;
+const int BVH_STACK_SIZE = BVH_MAX_DEPTH + 1;
+
+struct Aabb {
+    glm::vec3 min = glm::vec3(numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-numeric_limits<float>::max());
+
+    Aabb() {}
+    Aabb(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) {}
+
+    bool empty() const
+    {
+        return min.x > max.x;
+    }
+
+    void grow(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const Aabb &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    glm::vec3 center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    float surfaceArea() const
+    {
+        if (empty())
+            return 0.0f;
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    bool overlaps(const Aabb &other) const
+    {
+        return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y
+            && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    // box around this box after a transform
+    Aabb transformed(const glm::mat4 &matrix) const
+    {
+        if (empty())
+            return *this;
+        glm::vec3 center = glm::vec3(matrix * glm::vec4(this->center(), 1.0f)), extent = (max - min) * 0.5f, reach(0.0f);
+        for (int column = 0; column < 3; column++)
+            reach += glm::abs(glm::vec3(matrix[column])) * extent[column];
+        return Aabb(center - reach, center + reach);
+    }
+};
+
+// slab test, inverseDirection is 1 / direction per component. tNear is where the ray enters the box
+bool intersectRayAabb(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const Aabb &box, float maxT, float &tNear)
+{
+    glm::vec3 t0 = (box.min - origin) * inverseDirection, t1 = (box.max - origin) * inverseDirection;
+    glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+    tNear = max(max(tMin.x, tMin.y), max(tMin.z, 0.0f));
+    float tFar = min(min(tMax.x, tMax.y), min(tMax.z, maxT));
+    return tNear <= tFar;
+}
+
+// -1 when the box is completely outside the frustum, 1 when it's completely inside and 0 when it straddles a plane
+int classifyAabb(const Frustum &frustum, const Aabb &box)
+{
+    glm::vec3 center = box.center(), extent = (box.max - box.min) * 0.5f;
+    int result = 1;
+    for (const glm::vec4 &plane : frustum.planes)
+    {
+        glm::vec3 normal(plane);
+        float distance = glm::dot(normal, center) + plane.w, reach = glm::dot(glm::abs(normal), extent);
+        if (distance + reach < 0.0f)
+            return -1;
+        if (distance - reach < 0.0f)
+            result = 0;
+    }
+    return result;
+}
+
+// Bounding volume hierarchy over a set of boxes (scene objects, triangles...), built top down with binned SAH.
+// primitives are referred to by their index in the array passed to build. the tree can be refit when a primitive
+// moves, which keeps queries correct but slowly degrades it, so rebuild once a lot has moved.
+// the build stops splitting at BVH_MAX_DEPTH, so the queries can walk the tree with a fixed stack.
+class Bvh
+{
+public:
+    struct Node {
+        Aabb bounds;
+        int left = -1;   // the right child is left + 1
+        int parent = -1;
+        unsigned int first = 0, count = 0;  // primitives of a leaf, count is 0 for inner nodes
+    };
+
+    vector<Node> nodes;
+    vector<unsigned int> primitives;  // leaf ranges index into this, it holds indices into the build array
+
+    void build(const vector<Aabb> &bounds, unsigned int maxLeafSize = 4)
+    {
+        primitiveBounds = bounds;
+        this->maxLeafSize = max(1u, maxLeafSize);
+        nodes.clear();
+        primitives.resize(bounds.size());
+        leafOf.assign(bounds.size(), -1);
+        for (size_t i = 0; i < bounds.size(); i++)
+            primitives[i] = (unsigned int)i;
+        if (bounds.empty())
+            return;
+        nodes.reserve(bounds.size() * 2);
+        nodes.push_back(Node());
+        nodes[0].count = (unsigned int)bounds.size();
+        split(0, 0);
+    }
+
+    bool empty() const
+    {
+        return nodes.empty();
+    }
+
+    const Aabb &bounds(unsigned int primitive) const
+    {
+        return primitiveBounds[primitive];
+    }
+
+    // moves a primitive, the boxes on the path to the root are recomputed
+    void refit(unsigned int primitive, const Aabb &bounds)
+    {
+        primitiveBounds[primitive] = bounds;
+        for (int node = leafOf[primitive]; node >= 0; node = nodes[node].parent)
+        {
+            Node &current = nodes[node];
+            current.bounds = Aabb();
+            if (current.count)
+                for (unsigned int i = current.first; i < current.first + current.count; i++)
+                    current.bounds.grow(primitiveBounds[primitives[i]]);
+            else
+            {
+                current.bounds.grow(nodes[current.left].bounds);
+                current.bounds.grow(nodes[current.left + 1].bounds);
+            }
+        }
+    }
+
+    // calls visit(primitive, inside) for every primitive whose box may be in the frustum, inside is true when the
+    // primitive's box is certainly completely inside. subtrees completely inside aren't tested any further
+    template <typename Visit>
+    void queryFrustum(const Frustum &frustum, Visit visit) const
+    {
+        if (nodes.empty())
+            return;
+        int stack[BVH_STACK_SIZE], size = 0;
+        bool insideStack[BVH_STACK_SIZE];
+        stack[size] = 0;
+        insideStack[size++] = false;
+        while (size)
+        {
+            size--;
+            const Node &node = nodes[stack[size]];
+            bool inside = insideStack[size];
+            if (!inside)
+            {
+                int classification = classifyAabb(frustum, node.bounds);
+                if (classification < 0)
+                    continue;
+                inside = classification > 0;
+            }
+            if (node.count)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    if (inside || classifyAabb(frustum, primitiveBounds[primitives[i]]) >= 0)
+                        visit(primitives[i], inside);
+                continue;
+            }
+            assert(size + 2 <= BVH_STACK_SIZE);
+            for (int child = 0; child < 2; child++)
+            {
+                stack[size] = node.left + child;
+                insideStack[size++] = inside;
+            }
+        }
+    }
+
+    // walks the boxes hit by a ray, nearest first. hit(primitive, maxT) tests the primitive itself and
+    // lowers maxT when it finds a closer hit, boxes beyond maxT are skipped
+    template <typename Hit>
+    void queryRay(const glm::vec3 &origin, const glm::vec3 &direction, float &maxT, Hit hit) const
+    {
+        if (nodes.empty())
+            return;
+        glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        float tNear;
+        int stack[BVH_STACK_SIZE], size = 0;
+        stack[size++] = 0;
+        while (size)
+        {
+            const Node &node = nodes[stack[--size]];
+            if (!intersectRayAabb(origin, inverseDirection, node.bounds, maxT, tNear))
+                continue;
+            if (node.count)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    if (intersectRayAabb(origin, inverseDirection, primitiveBounds[primitives[i]], maxT, tNear))
+                        hit(primitives[i], maxT);
+                continue;
+            }
+            // push the far child first, so the near one is visited first and can shorten the ray
+            float tLeft, tRight;
+            bool hitLeft = intersectRayAabb(origin, inverseDirection, nodes[node.left].bounds, maxT, tLeft);
+            bool hitRight = intersectRayAabb(origin, inverseDirection, nodes[node.left + 1].bounds, maxT, tRight);
+            assert(size + 2 <= BVH_STACK_SIZE);
+            if (hitLeft && hitRight)
+            {
+                bool leftFirst = tLeft <= tRight;
+                stack[size++] = leftFirst ? node.left + 1 : node.left;
+                stack[size++] = leftFirst ? node.left : node.left + 1;
+            }
+            else if (hitLeft)
+                stack[size++] = node.left;
+            else if (hitRight)
+                stack[size++] = node.left + 1;
+        }
+    }
+
+    // calls visit(primitive) for every primitive whose box overlaps box
+    template <typename Visit>
+    void queryAabb(const Aabb &box, Visit visit) const
+    {
+        if (nodes.empty())
+            return;
+        int stack[BVH_STACK_SIZE], size = 0;
+        stack[size++] = 0;
+        while (size)
+        {
+            const Node &node = nodes[stack[--size]];
+            if (!node.bounds.overlaps(box))
+                continue;
+            if (node.count)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    if (primitiveBounds[primitives[i]].overlaps(box))
+                        visit(primitives[i]);
+                continue;
+            }
+            assert(size + 2 <= BVH_STACK_SIZE);
+            stack[size++] = node.left;
+            stack[size++] = node.left + 1;
+        }
+    }
+
+private:
+    vector<Aabb> primitiveBounds;
+    vector<int> leafOf;  // leaf node of each primitive, for refit
+    unsigned int maxLeafSize = 4;
+
+    struct Bin {
+        Aabb bounds;
+        unsigned int count = 0;
+    };
+
+    void split(int index, int depth)
+    {
+        // nodes may reallocate while children are added, so don't hold references across push_back
+        unsigned int first = nodes[index].first, count = nodes[index].count;
+        Aabb bounds, centroids;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            bounds.grow(primitiveBounds[primitives[i]]);
+            centroids.grow(primitiveBounds[primitives[i]].center());
+        }
+        nodes[index].bounds = bounds;
+
+        // binned SAH: the best plane between BVH_BINS bins along each axis of the centroid bounds
+        float bestCost = numeric_limits<float>::max();
+        int bestAxis = -1, bestSplit = 0;
+        if (count > maxLeafSize && depth < BVH_MAX_DEPTH)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float low = centroids.min[axis], extent = centroids.max[axis] - low;
+                if (extent <= 0.0f)
+                    continue;
+                Bin bins[BVH_BINS];
+                for (unsigned int i = first; i < first + count; i++)
+                {
+                    const Aabb &box = primitiveBounds[primitives[i]];
+                    int bin = min(BVH_BINS - 1, (int)((box.center()[axis] - low) / extent * BVH_BINS));
+                    bins[bin].bounds.grow(box);
+                    bins[bin].count++;
+                }
+                // sweep from the right to get the cost of every right side, then from the left
+                float rightArea[BVH_BINS];
+                unsigned int rightCount[BVH_BINS];
+                Aabb right;
+                unsigned int rightTotal = 0;
+                for (int b = BVH_BINS - 1; b > 0; b--)
+                {
+                    right.grow(bins[b].bounds);
+                    rightTotal += bins[b].count;
+                    rightArea[b] = right.surfaceArea();
+                    rightCount[b] = rightTotal;
+                }
+                Aabb left;
+                unsigned int leftTotal = 0;
+                for (int b = 0; b < BVH_BINS - 1; b++)
+                {
+                    left.grow(bins[b].bounds);
+                    leftTotal += bins[b].count;
+                    if (leftTotal == 0 || rightCount[b + 1] == 0)
+                        continue;
+                    float cost = left.surfaceArea() * leftTotal + rightArea[b + 1] * rightCount[b + 1];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = b;
+                    }
+                }
+            }
+        }
+
+        // stay a leaf when no split beats testing every primitive here
+        if (bestAxis < 0 || bestCost / max(bounds.surfaceArea(), 1e-12f) + BVH_TRAVERSAL_COST >= count)
+        {
+            if (count > maxLeafSize && bestAxis < 0 && depth < BVH_MAX_DEPTH)
+            {
+                // all centroids coincide, split in the middle of the list to honour maxLeafSize
+                bestAxis = 0;
+                bestSplit = -1;
+            }
+            else
+            {
+                for (unsigned int i = first; i < first + count; i++)
+                    leafOf[primitives[i]] = index;
+                return;
+            }
+        }
+
+        unsigned int middle;
+        if (bestSplit < 0)
+            middle = first + count / 2;
+        else
+        {
+            float low = centroids.min[bestAxis], extent = centroids.max[bestAxis] - low;
+            auto isLeft = [&](unsigned int primitive) {
+                int bin = min(BVH_BINS - 1, (int)((primitiveBounds[primitive].center()[bestAxis] - low) / extent * BVH_BINS));
+                return bin <= bestSplit;
+            };
+            middle = (unsigned int)(partition(primitives.begin() + first, primitives.begin() + first + count, isLeft) - primitives.begin());
+        }
+
+        int left = (int)nodes.size();
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[left].parent = nodes[left + 1].parent = index;
+        nodes[left].first = first;
+        nodes[left].count = middle - first;
+        nodes[left + 1].first = middle;
+        nodes[left + 1].count = first + count - middle;
+        nodes[index].left = left;
+        nodes[index].count = 0;
+        split(left, depth + 1);
+        split(left + 1, depth + 1);
+    }
+};
+#endif
@@ -15,12 +15,22 @@ enum Camera_Movement {
     RIGHT
 };
 
+// Keeps a moving camera out of scene geometry, see SceneBvh
+class CameraCollider
+{
+public:
+    virtual ~CameraCollider() {}
+    // where a sphere of the given radius moving from from to to ends up, sliding along whatever it hits
+    virtual glm::vec3 sweepSphere(const glm::vec3 &from, const glm::vec3 &to, float radius) const = 0;
+};
+
 // Default camera values
 const float YAW         = -90.0f;
 const float PITCH       =  0.0f;
 const float SPEED       =  2.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
+const float RADIUS      =  0.2f;
 
 
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
@@ -40,6 +50,9 @@ public:
     float MovementSpeed;
     float MouseSensitivity;
     float Zoom;
+    // collision, the camera is a sphere of CollisionRadius when a Collider is set
+    const CameraCollider *Collider = nullptr;
+    float CollisionRadius = RADIUS;
 
     // constructor with vectors
     Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
@@ -70,14 +83,16 @@ public:
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
         float velocity = MovementSpeed * deltaTime;
+        glm::vec3 target = Position;
         if (direction == FORWARD)
-            Position += Front * velocity;
+            target += Front * velocity;
         if (direction == BACKWARD)
-            Position -= Front * velocity;
+            target -= Front * velocity;
         if (direction == LEFT)
-            Position -= Right * velocity;
+            target -= Right * velocity;
         if (direction == RIGHT)
-            Position += Right * velocity;
+            target += Right * velocity;
+        Position = Collider ? Collider->sweepSphere(Position, target, CollisionRadius) : target;
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
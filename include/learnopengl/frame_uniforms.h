@@ -0,0 +1,97 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstddef>
+#include <iostream>
+using namespace std;
+
+// binding point of the Frame uniform block
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// The Frame uniform block of the shaders in std140 layout: every vec3 starts on 16 bytes, so the vec3s of the lights
+// are stored as vec4s, except the point light's last one, whose fourth float is where std140 puts constant.
+// keep in sync with the block in resources/shaders
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPosition;
+    // DirLight
+    glm::vec4 dirLightDirection;
+    glm::vec4 dirLightAmbient;
+    glm::vec4 dirLightDiffuse;
+    glm::vec4 dirLightSpecular;
+    // PointLight
+    glm::vec4 pointLightPosition;
+    glm::vec4 pointLightAmbient;
+    glm::vec4 pointLightDiffuse;
+    glm::vec3 pointLightSpecular;
+    float pointLightConstant;
+    float pointLightLinear;
+    float pointLightQuadratic;
+    float padding[2];  // a struct in std140 is rounded up to 16 bytes
+};
+
+static_assert(offsetof(FrameUniforms, viewPosition) == 128, "std140 offset of viewPosition");
+static_assert(offsetof(FrameUniforms, dirLightDirection) == 144, "std140 offset of dirLight");
+static_assert(offsetof(FrameUniforms, pointLightPosition) == 208, "std140 offset of pointLight");
+static_assert(offsetof(FrameUniforms, pointLightConstant) == 268, "std140 offset of pointLight.constant");
+static_assert(sizeof(FrameUniforms) == 288, "std140 size of the Frame block");
+
+// The buffer behind the Frame block, bound to FRAME_UNIFORM_BINDING once and rewritten once per frame,
+// so the programs don't need any of its uniforms set on them. needs a GL context
+class FrameUniformBuffer
+{
+public:
+    FrameUniformBuffer()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, UBO);
+    }
+
+    ~FrameUniformBuffer()
+    {
+        glDeleteBuffers(1, &UBO);
+    }
+
+    FrameUniformBuffer(const FrameUniformBuffer &) = delete;
+    FrameUniformBuffer &operator=(const FrameUniformBuffer &) = delete;
+
+    // points the program's Frame block at the buffer, and checks the block is laid out like FrameUniforms
+    void attach(const Shader &shader) const
+    {
+        GLuint index = glGetUniformBlockIndex(shader.ID, "Frame");
+        if (index == GL_INVALID_INDEX)
+        {
+            cout << "ERROR::FRAME_UNIFORMS:: program " << shader.ID << " has no Frame block" << endl;
+            return;
+        }
+        GLint size = 0;
+        glGetActiveUniformBlockiv(shader.ID, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        if (size != (GLint)sizeof(FrameUniforms))
+            cout << "ERROR::FRAME_UNIFORMS:: Frame block of program " << shader.ID << " is " << size << " bytes, expected "
+                 << sizeof(FrameUniforms) << endl;
+        glUniformBlockBinding(shader.ID, index, FRAME_UNIFORM_BINDING);
+    }
+
+    void update(const FrameUniforms &frame)
+    {
+        // orphaning the old storage keeps the driver from waiting on the draws of the last frame that still read it
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int UBO = 0;
+};
+#endif
@@ -0,0 +1,150 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SSE2 1
+#endif
+
+// six planes (left, right, bottom, top, near, far) as (normal, distance), pointing into the frustum:
+// a point p is inside a plane when dot(normal, p) + distance >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // extracts the planes from a (projection * view * model) matrix, they end up in the space that matrix maps from.
+    // planes are left unnormalized, the tests below account for that
+    static Frustum fromMatrix(const glm::mat4 &matrix)
+    {
+        // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+        glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+        glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+        glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0;
+        frustum.planes[1] = row3 - row0;
+        frustum.planes[2] = row3 + row1;
+        frustum.planes[3] = row3 - row1;
+        frustum.planes[4] = row3 + row2;
+        frustum.planes[5] = row3 - row2;
+        return frustum;
+    }
+};
+
+// meshes tested against the frustum in a frame, and how many of them were skipped
+struct CullingStats {
+    size_t submitted = 0;
+    size_t culled = 0;
+};
+
+// Bounding spheres and boxes of a set of meshes, one array per component so four of them are tested at once.
+// the arrays are padded with zeros to a multiple of 4, results for the padding lanes are never written.
+struct CullingBounds {
+    vector<float> centerX, centerY, centerZ, radius;  // bounding spheres
+    vector<float> boxX, boxY, boxZ;                   // box centers
+    vector<float> extentX, extentY, extentZ;          // box half sizes
+    size_t count = 0;
+
+    void add(const glm::vec3 &sphereCenter, float sphereRadius, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        // drop the padding, append, then pad again
+        resize(count);
+        centerX.push_back(sphereCenter.x);
+        centerY.push_back(sphereCenter.y);
+        centerZ.push_back(sphereCenter.z);
+        radius.push_back(sphereRadius);
+        glm::vec3 center = (boxMin + boxMax) * 0.5f, extent = (boxMax - boxMin) * 0.5f;
+        boxX.push_back(center.x);
+        boxY.push_back(center.y);
+        boxZ.push_back(center.z);
+        extentX.push_back(extent.x);
+        extentY.push_back(extent.y);
+        extentZ.push_back(extent.z);
+        count++;
+        resize((count + 3) & ~(size_t)3);
+    }
+
+    void clear()
+    {
+        count = 0;
+        resize(0);
+    }
+
+private:
+    void resize(size_t size)
+    {
+        for (vector<float> *array : {&centerX, &centerY, &centerZ, &radius, &boxX, &boxY, &boxZ, &extentX, &extentY, &extentZ})
+            array->resize(size, 0.0f);
+    }
+};
+
+// Tests every sphere and box against the frustum, visible[i] is set to 1 when bounds i may be visible, 0 otherwise.
+// a mesh is culled when its sphere or its box lies completely behind one of the planes. With a frustum taken from
+// projection * view * model both tests stay exact under the model matrix, scaled spheres become ellipsoids whose
+// reach along a plane's normal is the radius times the length of the model space normal.
+// returns the number of visible bounds
+size_t cullBounds(const Frustum &frustum, const CullingBounds &bounds, unsigned char *visible)
+{
+    float lengths[6];
+    for (int p = 0; p < 6; p++)
+        lengths[p] = glm::length(glm::vec3(frustum.planes[p]));
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < bounds.count; i += 4)
+    {
+#ifdef FRUSTUM_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]), cy = _mm_loadu_ps(&bounds.centerY[i]), cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 r = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 bx = _mm_loadu_ps(&bounds.boxX[i]), by = _mm_loadu_ps(&bounds.boxY[i]), bz = _mm_loadu_ps(&bounds.boxZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]), ey = _mm_loadu_ps(&bounds.extentY[i]), ez = _mm_loadu_ps(&bounds.extentZ[i]);
+        __m128 outside = zero;
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z), w = _mm_set1_ps(plane.w);
+            // sphere: center further behind the plane than the radius
+            __m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), w));
+            __m128 sphereOut = _mm_cmplt_ps(_mm_add_ps(sphereDistance, _mm_mul_ps(r, _mm_set1_ps(lengths[p]))), zero);
+            // box: even the corner furthest along the normal is behind the plane
+            __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, bx), _mm_mul_ps(ny, by)), _mm_add_ps(_mm_mul_ps(nz, bz), w));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, signMask), ex), _mm_mul_ps(_mm_and_ps(ny, signMask), ey)),
+                                      _mm_mul_ps(_mm_and_ps(nz, signMask), ez));
+            __m128 boxOut = _mm_cmplt_ps(_mm_add_ps(boxDistance, reach), zero);
+            outside = _mm_or_ps(outside, _mm_or_ps(sphereOut, boxOut));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4 && i + lane < bounds.count; lane++)
+        {
+            visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+            visibleCount += visible[i + lane];
+        }
+#else
+        for (size_t lane = 0; lane < 4 && i + lane < bounds.count; lane++)
+        {
+            size_t j = i + lane;
+            bool outside = false;
+            for (int p = 0; p < 6 && !outside; p++)
+            {
+                const glm::vec4 &plane = frustum.planes[p];
+                float sphereDistance = plane.x * bounds.centerX[j] + plane.y * bounds.centerY[j] + plane.z * bounds.centerZ[j] + plane.w;
+                float boxDistance = plane.x * bounds.boxX[j] + plane.y * bounds.boxY[j] + plane.z * bounds.boxZ[j] + plane.w;
+                float reach = fabs(plane.x) * bounds.extentX[j] + fabs(plane.y) * bounds.extentY[j] + fabs(plane.z) * bounds.extentZ[j];
+                outside = sphereDistance + bounds.radius[j] * lengths[p] < 0.0f || boxDistance + reach < 0.0f;
+            }
+            visible[j] = outside ? 0 : 1;
+            visibleCount += visible[j];
+        }
+#endif
+    }
+    return visibleCount;
+}
+#endif
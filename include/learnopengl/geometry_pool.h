@@ -0,0 +1,335 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/index_encoding.h>
+#include <learnopengl/vertex_format.h>
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// vertices and indices get 4 MB each per layout to start with, buffers double whenever they run out
+const size_t GEOMETRY_POOL_VERTEX_BYTES = 4 * 1024 * 1024;
+const size_t GEOMETRY_POOL_INDEX_BYTES = 4 * 1024 * 1024;
+// per instance attribute holding the index of an indirect draw, see GeometryPool::setDrawIdBuffer
+const unsigned int DRAW_ID_ATTRIBUTE = 5;
+
+// interleaved vertex layout: attribute offsets are relative to the start of a vertex
+struct VertexLayout {
+    size_t stride = 0;
+    vector<VertexAttribute> attributes;
+
+    bool operator==(const VertexLayout &other) const
+    {
+        if (stride != other.stride || attributes.size() != other.attributes.size())
+            return false;
+        for (size_t i = 0; i < attributes.size(); i++)
+        {
+            const VertexAttribute &a = attributes[i], &b = other.attributes[i];
+            if (a.location != b.location || a.components != b.components || a.type != b.type
+                || a.normalized != b.normalized || a.offset != b.offset)
+                return false;
+        }
+        return true;
+    }
+};
+
+// where a mesh lives in the pool, draw it with glDrawElementsBaseVertex on VAO
+struct GeometryAllocation {
+    int layout = -1;
+    unsigned int VAO = 0;
+    unsigned int firstVertex = 0;  // the base vertex
+    unsigned int vertexCount = 0;
+    size_t indexOffset = 0;        // in bytes, indices of different widths share the index buffer
+    size_t indexBytes = 0;
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLenum primitive = GL_TRIANGLES;
+
+    bool valid() const
+    {
+        return layout >= 0;
+    }
+};
+
+// first fit allocator over [0, capacity), in whatever unit the caller uses
+class RangeAllocator
+{
+public:
+    size_t capacity = 0;
+
+    bool allocate(size_t size, size_t &offset)
+    {
+        for (size_t i = 0; i < freeRanges.size(); i++)
+        {
+            if (freeRanges[i].second < size)
+                continue;
+            offset = freeRanges[i].first;
+            freeRanges[i].first += size;
+            freeRanges[i].second -= size;
+            if (freeRanges[i].second == 0)
+                freeRanges.erase(freeRanges.begin() + i);
+            return true;
+        }
+        return false;
+    }
+
+    // returns a range, merging it with free neighbours
+    void release(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        size_t i = 0;
+        while (i < freeRanges.size() && freeRanges[i].first < offset)
+            i++;
+        freeRanges.insert(freeRanges.begin() + i, make_pair(offset, size));
+        if (i + 1 < freeRanges.size() && freeRanges[i].first + freeRanges[i].second == freeRanges[i + 1].first)
+        {
+            freeRanges[i].second += freeRanges[i + 1].second;
+            freeRanges.erase(freeRanges.begin() + i + 1);
+        }
+        if (i > 0 && freeRanges[i - 1].first + freeRanges[i - 1].second == freeRanges[i].first)
+        {
+            freeRanges[i - 1].second += freeRanges[i].second;
+            freeRanges.erase(freeRanges.begin() + i);
+        }
+    }
+
+    void grow(size_t newCapacity)
+    {
+        size_t added = newCapacity - capacity;
+        size_t end = capacity;
+        capacity = newCapacity;
+        release(end, added);
+    }
+
+    size_t freeSize() const
+    {
+        size_t size = 0;
+        for (const auto &range : freeRanges)
+            size += range.second;
+        return size;
+    }
+
+private:
+    vector<pair<size_t, size_t>> freeRanges; // (offset, size), sorted by offset
+};
+
+// Shared vertex and index buffers that meshes are suballocated from, one set (and one VAO) per vertex layout.
+// meshes of the same layout can then be drawn back to back without rebinding anything but textures.
+// must only be used on the GL thread.
+class GeometryPool
+{
+public:
+    static GeometryPool &shared()
+    {
+        static GeometryPool pool;
+        return pool;
+    }
+
+    // copies vertexCount vertices of the given layout and their indices (relative to the first vertex) into the pool
+    GeometryAllocation allocate(const VertexLayout &layout, const void *vertices, size_t vertexCount, const EncodedIndices &indices)
+    {
+        GeometryAllocation allocation;
+        allocation.layout = findLayout(layout);
+        Buffers &buffers = *pools[allocation.layout];
+        allocation.VAO = buffers.VAO;
+
+        size_t firstVertex;
+        if (!buffers.vertexRanges.allocate(vertexCount, firstVertex))
+        {
+            growVertices(buffers, vertexCount);
+            buffers.vertexRanges.allocate(vertexCount, firstVertex);
+        }
+        allocation.firstVertex = (unsigned int)firstVertex;
+        allocation.vertexCount = (unsigned int)vertexCount;
+
+        // upload through the copy target, binding the element buffer would change the currently bound VAO
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstVertex * layout.stride, vertexCount * layout.stride, vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        uploadIndices(buffers, allocation, indices);
+        return allocation;
+    }
+
+    // another index buffer over the vertices of an existing allocation, as used by mesh LODs.
+    // the result only owns its indices, releasing it leaves the vertices alone
+    GeometryAllocation allocateIndices(const GeometryAllocation &vertices, const EncodedIndices &indices)
+    {
+        GeometryAllocation allocation = vertices;
+        allocation.vertexCount = 0;
+        uploadIndices(*pools[allocation.layout], allocation, indices);
+        return allocation;
+    }
+
+    void release(const GeometryAllocation &allocation)
+    {
+        if (!allocation.valid())
+            return;
+        Buffers &buffers = *pools[allocation.layout];
+        buffers.vertexRanges.release(allocation.firstVertex, allocation.vertexCount);
+        buffers.indexRanges.release(allocation.indexOffset, allocation.indexBytes);
+    }
+
+    // feeds DRAW_ID_ATTRIBUTE of every VAO from buffer, one unsigned int per instance. indirect draws set their
+    // base instance to their index, so the first instance of each draw reads its own index (GL 4.3 has no gl_DrawID).
+    // the attribute is left disabled: the buffer only holds as many ids as there are indirect draws, so the indirect
+    // batches enable it around their draw and instanced draws through the same VAOs never read past its end
+    void setDrawIdBuffer(unsigned int buffer)
+    {
+        drawIdBuffer = buffer;
+        for (const auto &buffers : pools)
+            bindBuffers(*buffers);
+    }
+
+    // number of vertex layouts, and so of VAOs and buffer pairs
+    size_t layoutCount() const
+    {
+        return pools.size();
+    }
+
+    // bytes allocated on the GPU, and how many of them hold geometry
+    size_t capacityBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &buffers : pools)
+            bytes += buffers->vertexRanges.capacity * buffers->layout.stride + buffers->indexRanges.capacity;
+        return bytes;
+    }
+
+    size_t usedBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &buffers : pools)
+            bytes += (buffers->vertexRanges.capacity - buffers->vertexRanges.freeSize()) * buffers->layout.stride
+                   + (buffers->indexRanges.capacity - buffers->indexRanges.freeSize());
+        return bytes;
+    }
+
+private:
+    struct Buffers {
+        VertexLayout layout;
+        unsigned int VAO = 0;
+        unsigned int vertexBuffer = 0;
+        unsigned int indexBuffer = 0;
+        RangeAllocator vertexRanges;  // in vertices
+        RangeAllocator indexRanges;   // in bytes
+    };
+
+    vector<unique_ptr<Buffers>> pools;
+    unsigned int drawIdBuffer = 0;
+
+    void uploadIndices(Buffers &buffers, GeometryAllocation &allocation, const EncodedIndices &indices)
+    {
+        // index ranges are kept 4 byte aligned, so both index widths can start anywhere
+        size_t indexBytes = (indices.data.size() + 3) & ~(size_t)3;
+        size_t indexOffset;
+        if (!buffers.indexRanges.allocate(indexBytes, indexOffset))
+        {
+            growIndices(buffers, indexBytes);
+            buffers.indexRanges.allocate(indexBytes, indexOffset);
+        }
+        allocation.indexOffset = indexOffset;
+        allocation.indexBytes = indexBytes;
+        allocation.indexCount = (unsigned int)indices.count;
+        allocation.indexType = indices.type;
+        allocation.primitive = indices.primitive;
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers.indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, indices.data.size(), indices.data.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    int findLayout(const VertexLayout &layout)
+    {
+        for (size_t i = 0; i < pools.size(); i++)
+            if (pools[i]->layout == layout)
+                return (int)i;
+
+        unique_ptr<Buffers> buffers(new Buffers());
+        buffers->layout = layout;
+        glGenVertexArrays(1, &buffers->VAO);
+        size_t vertexCapacity = GEOMETRY_POOL_VERTEX_BYTES / layout.stride;
+        buffers->vertexBuffer = createBuffer(vertexCapacity * layout.stride);
+        buffers->indexBuffer = createBuffer(GEOMETRY_POOL_INDEX_BYTES);
+        buffers->vertexRanges.grow(vertexCapacity);
+        buffers->indexRanges.grow(GEOMETRY_POOL_INDEX_BYTES);
+        bindBuffers(*buffers);
+        pools.push_back(move(buffers));
+        return (int)pools.size() - 1;
+    }
+
+    static unsigned int createBuffer(size_t bytes)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // points the layout's VAO at its (possibly new) buffers
+    void bindBuffers(const Buffers &buffers) const
+    {
+        glBindVertexArray(buffers.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.vertexBuffer);
+        for (const VertexAttribute &attribute : buffers.layout.attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                                  (GLsizei)buffers.layout.stride, (void*)attribute.offset);
+        }
+        if (drawIdBuffer)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+            glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+            glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, (void*)0);
+            glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.indexBuffer);
+        glBindVertexArray(0);
+    }
+
+    // replaces a buffer with a bigger copy of itself
+    static unsigned int growBuffer(unsigned int buffer, size_t oldBytes, size_t newBytes)
+    {
+        unsigned int grown = createBuffer(newBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        return grown;
+    }
+
+    static size_t grownCapacity(size_t capacity, size_t required)
+    {
+        size_t grown = capacity * 2;
+        while (grown < capacity + required)
+            grown *= 2;
+        return grown;
+    }
+
+    void growVertices(Buffers &buffers, size_t required)
+    {
+        size_t capacity = buffers.vertexRanges.capacity, grown = grownCapacity(capacity, required);
+        buffers.vertexBuffer = growBuffer(buffers.vertexBuffer, capacity * buffers.layout.stride, grown * buffers.layout.stride);
+        buffers.vertexRanges.grow(grown);
+        bindBuffers(buffers);
+    }
+
+    void growIndices(Buffers &buffers, size_t required)
+    {
+        size_t capacity = buffers.indexRanges.capacity, grown = grownCapacity(capacity, required);
+        buffers.indexBuffer = growBuffer(buffers.indexBuffer, capacity, grown);
+        buffers.indexRanges.grow(grown);
+        bindBuffers(buffers);
+    }
+};
+#endif
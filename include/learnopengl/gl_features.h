@@ -0,0 +1,48 @@
+#ifndef GL_FEATURES_H
+#define GL_FEATURES_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+using namespace std;
+
+// glad is generated for GL 3.3 core, the few GL 4.3 names the multi draw path needs are declared here
+// and loaded by detectGLFeatures when the context has them
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+
+typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount,
+                                                         GLsizei stride);
+
+// what the context can do beyond GL 3.3, filled once at startup
+struct GLFeatures {
+    int major = 3;
+    int minor = 3;
+    bool multiDrawIndirect = false;  // glMultiDrawElementsIndirect, shader storage buffers and GLSL 4.30
+    PFNMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+};
+
+GLFeatures &glFeatures()
+{
+    static GLFeatures features;
+    return features;
+}
+
+// call after gladLoadGLLoader with the same loader, on the GL thread
+const GLFeatures &detectGLFeatures(GLADloadproc load)
+{
+    GLFeatures &features = glFeatures();
+    features.major = GLVersion.major;
+    features.minor = GLVersion.minor;
+    if (features.major > 4 || (features.major == 4 && features.minor >= 3))
+        features.multiDrawIndirect = (features.multiDrawElementsIndirect =
+                                      (PFNMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect")) != nullptr;
+    cout << "GL::FEATURES:: OpenGL " << features.major << "." << features.minor << ", multi draw indirect "
+         << (features.multiDrawIndirect ? "on" : "off") << endl;
+    return features;
+}
+#endif
@@ -0,0 +1,62 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// 64 bit FNV-1a, for short keys (paths, names)
+uint64_t fnv1a64(const void *data, size_t size, uint64_t h = 14695981039346656037ull)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// fnv1a64 of a null terminated string, constexpr so names written in the source can be hashed by the compiler
+constexpr uint64_t hashName(const char *name, uint64_t h = 14695981039346656037ull)
+{
+    while (*name)
+    {
+        h ^= (unsigned char)*name++;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 64 bit hash for large buffers (file contents), eight bytes per step with a murmur style finalizer.
+// not cryptographic, only meant to tell identical files apart from different ones.
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0)
+{
+    const uint64_t k1 = 0x9E3779B185EBCA87ull;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4Full;
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t h = seed ^ (size * k1);
+
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t w;
+        memcpy(&w, bytes + i * 8, 8);
+        w *= k2;
+        w = (w << 31) | (w >> 33);
+        w *= k1;
+        h ^= w;
+        h = ((h << 27) | (h >> 37)) * k1 + k2;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + words * 8, size - words * 8);
+    h ^= tail * k2;
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+#endif
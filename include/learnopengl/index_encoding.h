@@ -0,0 +1,139 @@
+#ifndef INDEX_ENCODING_H
+#define INDEX_ENCODING_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// index buffer as it is uploaded: 16 bit where the vertex count allows, and either a triangle list
+// or triangle strips separated by the primitive restart index
+struct EncodedIndices {
+    vector<unsigned char> data;
+    GLenum type = GL_UNSIGNED_INT;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum primitive = GL_TRIANGLES;  // GL_TRIANGLES or GL_TRIANGLE_STRIP
+    size_t count = 0;
+
+    size_t indexSize() const
+    {
+        return type == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+    unsigned int restartIndex() const
+    {
+        return type == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF;
+    }
+};
+
+const unsigned int STRIP_RESTART = 0xFFFFFFFF;
+
+// Turns a triangle list into strips separated by STRIP_RESTART. Greedy: triangles are taken in list order (which is
+// vertex cache order after optimizeVertexCache) and every strip is extended for as long as an unused triangle shares
+// its last edge with the right winding. Triangle winding is preserved.
+vector<unsigned int> stripifyIndices(const vector<unsigned int> &indices, size_t vertexCount)
+{
+    size_t triangleCount = indices.size() / 3;
+    // triangles using each vertex, as offsets into one array
+    vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (unsigned int index : indices)
+        adjacencyOffset[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    vector<bool> used(triangleCount, false);
+    // finds an unused triangle with the directed edge a -> b, returns its third vertex
+    auto findTriangle = [&](unsigned int a, unsigned int b, unsigned int &third) -> int {
+        for (unsigned int i = adjacencyOffset[a]; i < adjacencyOffset[a + 1]; i++)
+        {
+            unsigned int t = adjacency[i];
+            if (used[t])
+                continue;
+            const unsigned int *triangle = &indices[t * 3];
+            for (int k = 0; k < 3; k++)
+            {
+                if (triangle[k] == a && triangle[(k + 1) % 3] == b)
+                {
+                    third = triangle[(k + 2) % 3];
+                    return (int)t;
+                }
+            }
+        }
+        return -1;
+    };
+
+    vector<unsigned int> strips;
+    strips.reserve(indices.size());
+    for (size_t start = 0; start < triangleCount; start++)
+    {
+        if (used[start])
+            continue;
+        used[start] = true;
+        const unsigned int *triangle = &indices[start * 3];
+        // start with the rotation whose last edge can be continued, the next triangle in a strip is flipped,
+        // so it has to hold the last edge backwards
+        int rotation = 0;
+        unsigned int third;
+        for (int r = 0; r < 3; r++)
+        {
+            if (findTriangle(triangle[(r + 2) % 3], triangle[(r + 1) % 3], third) >= 0)
+            {
+                rotation = r;
+                break;
+            }
+        }
+        if (!strips.empty())
+            strips.push_back(STRIP_RESTART);
+        for (int k = 0; k < 3; k++)
+            strips.push_back(triangle[(rotation + k) % 3]);
+
+        // triangle n of a strip is (s[n], s[n + 1], s[n + 2]) for even n and (s[n + 1], s[n], s[n + 2]) for odd n
+        for (size_t n = 1; ; n++)
+        {
+            unsigned int a = strips[strips.size() - 2], b = strips[strips.size() - 1];
+            int next = n % 2 ? findTriangle(b, a, third) : findTriangle(a, b, third);
+            if (next < 0)
+                break;
+            used[next] = true;
+            strips.push_back(third);
+        }
+    }
+    return strips;
+}
+
+// picks the smallest encoding of a triangle list over vertexCount vertices: 16 bit indices when every index
+// (and the restart index) fits, and strips when allowStrips is set and they come out shorter than the list
+void encodeIndices(const vector<unsigned int> &indices, size_t vertexCount, bool allowStrips, EncodedIndices &encoded)
+{
+    encoded.type = vertexCount < 0xFFFF ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    encoded.primitive = GL_TRIANGLES;
+    const vector<unsigned int> *source = &indices;
+    vector<unsigned int> strips;
+    if (allowStrips)
+    {
+        strips = stripifyIndices(indices, vertexCount);
+        if (strips.size() < indices.size())
+        {
+            source = &strips;
+            encoded.primitive = GL_TRIANGLE_STRIP;
+        }
+    }
+
+    encoded.count = source->size();
+    encoded.data.resize(encoded.count * encoded.indexSize());
+    if (encoded.type == GL_UNSIGNED_INT)
+    {
+        memcpy(encoded.data.data(), source->data(), encoded.data.size());
+        return;
+    }
+    uint16_t *narrow = (uint16_t *)encoded.data.data();
+    for (size_t i = 0; i < encoded.count; i++)
+        narrow[i] = (uint16_t)(*source)[i]; // STRIP_RESTART becomes 0xFFFF
+}
+#endif
@@ -0,0 +1,279 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+using namespace std;
+
+// first of the four locations the per instance model matrix takes, a column each (see 2.model_lighting_instanced.vs)
+const GLuint INSTANCE_MATRIX_ATTRIBUTE = 6;
+
+// Model matrices of instances in a GL buffer. the instanced shaders read them as a vertex attribute that advances
+// once per instance, so one draw call draws every instance of a range. needs a GL context
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() = default;
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    ~InstanceBuffer()
+    {
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    }
+
+    // fresh storage on every update, so the driver never waits for the draws still reading the old transforms
+    void update(const glm::mat4 *transforms, size_t count)
+    {
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), transforms, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        instanceCount = count;
+    }
+
+    void update(const vector<glm::mat4> &transforms)
+    {
+        update(transforms.data(), transforms.size());
+    }
+
+    size_t size() const
+    {
+        return instanceCount;
+    }
+
+    // points the instance matrix of the bound VAO at the buffer, instance 0 of the next draw reads transform first.
+    // vertex arrays are shared by the meshes of a layout (see GeometryPool), so disable it again after the draw
+    void bindAttributes(size_t first) const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (GLuint column = 0; column < 4; column++)
+        {
+            GLuint location = INSTANCE_MATRIX_ATTRIBUTE + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                  (void *)(first * sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void unbindAttributes()
+    {
+        for (GLuint column = 0; column < 4; column++)
+            glDisableVertexAttribArray(INSTANCE_MATRIX_ATTRIBUTE + column);
+    }
+
+private:
+    unsigned int buffer = 0;
+    size_t instanceCount = 0;
+};
+
+// bounds of all the meshes of a model, in model space. the sphere is centered on the box
+Bounds modelBounds(const Model &model)
+{
+    Bounds bounds;
+    if (model.meshes.empty())
+        return bounds;
+    bounds.min = model.meshes[0].bounds.min;
+    bounds.max = model.meshes[0].bounds.max;
+    for (const Mesh &mesh : model.meshes)
+    {
+        bounds.min = glm::min(bounds.min, mesh.bounds.min);
+        bounds.max = glm::max(bounds.max, mesh.bounds.max);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    for (const Mesh &mesh : model.meshes)
+        bounds.radius = max(bounds.radius, glm::length(mesh.bounds.center - bounds.center) + mesh.bounds.radius);
+    return bounds;
+}
+
+// The same model drawn many times, each instance with its own transform. update() culls the instances against the
+// frustum and picks a level of detail per instance and mesh, then groups the visible instances by mesh and level into
+// ranges of one InstanceBuffer. each range is one instanced draw, see RenderQueue::submitInstances or Draw.
+// the meshes' own lod and visible are left alone, so the model can still be drawn on its own as well
+class ModelInstances
+{
+public:
+    // instances of a mesh at one level of detail, transforms first to first + count of the buffer
+    struct Range {
+        Mesh *mesh;
+        unsigned int lod;
+        size_t first;
+        size_t count;
+        glm::vec3 nearest;  // position of the instance closest to the camera, for sorting
+    };
+
+    Model &model;
+
+    explicit ModelInstances(Model &model) : model(model)
+    {
+    }
+
+    ModelInstances(const ModelInstances &) = delete;
+    ModelInstances &operator=(const ModelInstances &) = delete;
+
+    void setTransforms(vector<glm::mat4> transforms)
+    {
+        instanceTransforms = move(transforms);
+        boundsBuilt = false;
+    }
+
+    const vector<glm::mat4> &transforms() const
+    {
+        return instanceTransforms;
+    }
+
+    // culls and picks the levels for this frame and uploads the visible transforms, on the GL thread. transform is the
+    // model matrix the instances are drawn under, like in Model::Cull. returns the number of triangles that will be drawn
+    size_t update(const glm::mat4 &projectionView, const glm::mat4 &transform, const LodContext &context, CullingStats &stats)
+    {
+        instanceRanges.clear();
+        if (!model.isLoaded() || instanceTransforms.empty())
+            return 0;
+        if (!boundsBuilt)
+            buildBounds();
+
+        vector<Mesh> &meshes = model.meshes;
+        size_t instanceCount = instanceTransforms.size();
+        visibility.resize(instanceCount);
+        size_t visible = cullBounds(Frustum::fromMatrix(projectionView * transform), bounds, visibility.data());
+        stats.submitted += visible;
+        stats.culled += instanceCount - visible;
+
+        // a slot per mesh and level, slotBase[m] + level
+        slotBase.resize(meshes.size());
+        size_t slotCount = 0;
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            slotBase[m] = slotCount;
+            slotCount += meshes[m].lods.size() + 1;
+        }
+        slotFirst.assign(slotCount, 0);
+        slotNearest.assign(slotCount, numeric_limits<float>::max());
+        slotPositions.resize(slotCount);
+        levels.resize(instanceCount * meshes.size(), 0);
+
+        // pick the levels and count the instances of each slot
+        for (size_t i = 0; i < instanceCount; i++)
+        {
+            if (!visibility[i])
+                continue;
+            glm::mat4 instance = transform * instanceTransforms[i];
+            float scale = maxAxisScale(instance);
+            for (size_t m = 0; m < meshes.size(); m++)
+            {
+                const Mesh &mesh = meshes[m];
+                glm::vec3 center = glm::vec3(instance * glm::vec4(mesh.bounds.center, 1.0f));
+                unsigned int &level = levels[i * meshes.size() + m];
+                level = selectLodLevel(mesh.lods, level, context.radiusPixels(center, mesh.bounds.radius * scale), context.bias);
+                size_t slot = slotBase[m] + level;
+                slotFirst[slot]++;
+                float distance = glm::length(center - context.viewPosition);
+                if (distance < slotNearest[slot])
+                {
+                    slotNearest[slot] = distance;
+                    slotPositions[slot] = center;
+                }
+            }
+        }
+
+        // counts to ranges, then scatter the transforms into them
+        size_t triangles = 0, offset = 0;
+        for (size_t m = 0; m < meshes.size(); m++)
+            for (unsigned int level = 0; level <= meshes[m].lods.size(); level++)
+            {
+                size_t slot = slotBase[m] + level, count = slotFirst[slot];
+                slotFirst[slot] = offset;
+                if (count == 0)
+                    continue;
+                instanceRanges.push_back(Range{&meshes[m], level, offset, count, slotPositions[slot]});
+                triangles += count * meshes[m].levelTriangleCount(level);
+                offset += count;
+            }
+        visibleTransforms.resize(offset);
+        for (size_t i = 0; i < instanceCount; i++)
+        {
+            if (!visibility[i])
+                continue;
+            for (size_t m = 0; m < meshes.size(); m++)
+                visibleTransforms[slotFirst[slotBase[m] + levels[i * meshes.size() + m]]++] = instanceTransforms[i];
+        }
+        instanceBuffer.update(visibleTransforms);
+        return triangles;
+    }
+
+    // what the last update left to draw
+    const vector<Range> &ranges() const
+    {
+        return instanceRanges;
+    }
+
+    const InstanceBuffer &buffer() const
+    {
+        return instanceBuffer;
+    }
+
+    // draws the ranges of the last update without a render queue, shader reads the instance matrix and its
+    // model matrix and samplers (see setMaterialSamplers) must already be set
+    void Draw(Shader &shader)
+    {
+        MeshUniforms uniforms(shader);
+        for (const Range &range : instanceRanges)
+        {
+            glBindVertexArray(range.mesh->VAO);
+            range.mesh->BindTextures();
+            instanceBuffer.bindAttributes(range.first);
+            range.mesh->DrawGeometry(uniforms, range.lod, (GLsizei)range.count);
+            InstanceBuffer::unbindAttributes();
+        }
+        glBindVertexArray(0);
+    }
+
+private:
+    vector<glm::mat4> instanceTransforms;
+    bool boundsBuilt = false;
+    CullingBounds bounds;  // of every instance, in the space the transforms map to
+    vector<unsigned char> visibility;
+    vector<unsigned int> levels;  // per instance and mesh, kept between frames for the hysteresis
+    vector<size_t> slotBase, slotFirst;
+    vector<float> slotNearest;
+    vector<glm::vec3> slotPositions;
+    vector<glm::mat4> visibleTransforms;
+    vector<Range> instanceRanges;
+    InstanceBuffer instanceBuffer;
+
+    // the model's box and sphere moved by each transform, once per setTransforms
+    void buildBounds()
+    {
+        Bounds local = modelBounds(model);
+        glm::vec3 boxCenter = (local.min + local.max) * 0.5f, boxExtent = (local.max - local.min) * 0.5f;
+        bounds.clear();
+        for (const glm::mat4 &transform : instanceTransforms)
+        {
+            glm::vec3 center = glm::vec3(transform * glm::vec4(boxCenter, 1.0f));
+            // the box around the transformed box, each axis reaches as far as the columns scaled by the extent
+            glm::vec3 extent = glm::abs(glm::vec3(transform[0])) * boxExtent.x + glm::abs(glm::vec3(transform[1])) * boxExtent.y
+                               + glm::abs(glm::vec3(transform[2])) * boxExtent.z;
+            bounds.add(glm::vec3(transform * glm::vec4(local.center, 1.0f)), local.radius * maxAxisScale(transform),
+                       center - extent, center + extent);
+        }
+        levels.assign(instanceTransforms.size() * model.meshes.size(), 0);
+        boundsBuilt = true;
+    }
+};
+#endif
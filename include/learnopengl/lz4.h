@@ -0,0 +1,157 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// LZ4 block format (no frame header), as used by the entries of the asset archive. the compressor is a plain greedy
+// one with a single hash probe, it trades some ratio for speed; anything written by the reference LZ4 block
+// compressor decompresses here too.
+
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;   // the block always ends with at least this many literals
+const size_t LZ4_MATCH_LIMIT = 12;    // no match may start closer than this to the end
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_BITS = 16;
+
+// largest compressed size of n bytes, for incompressible data
+size_t lz4CompressBound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+namespace lz4_detail {
+
+inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+// a length of 15 or more continues in bytes of 255 and a remainder
+inline unsigned char *writeLength(unsigned char *out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+inline unsigned char *writeSequence(unsigned char *out, const unsigned char *literals, size_t literalLength,
+                                    size_t offset, size_t matchLength)
+{
+    unsigned char *token = out++;
+    *token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+    if (literalLength >= 15)
+        out = writeLength(out, literalLength - 15);
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+    if (matchLength == 0)
+        return out;
+    *out++ = (unsigned char)(offset & 0xFF);
+    *out++ = (unsigned char)(offset >> 8);
+    matchLength -= LZ4_MIN_MATCH;
+    *token |= (unsigned char)(matchLength >= 15 ? 15 : matchLength);
+    if (matchLength >= 15)
+        out = writeLength(out, matchLength - 15);
+    return out;
+}
+
+} // namespace lz4_detail
+
+// compresses size bytes into compressed, which is resized to what was written
+void lz4Compress(const unsigned char *source, size_t size, vector<unsigned char> &compressed)
+{
+    using namespace lz4_detail;
+    compressed.resize(lz4CompressBound(size));
+    unsigned char *out = compressed.data();
+    size_t anchor = 0;
+    if (size > LZ4_MATCH_LIMIT)
+    {
+        // positions + 1 of the last sequence with each hash, 0 for none
+        vector<uint32_t> table((size_t)1 << LZ4_HASH_BITS, 0);
+        size_t matchStartLimit = size - LZ4_MATCH_LIMIT, matchEndLimit = size - LZ4_LAST_LITERALS;
+        size_t position = 0;
+        while (position < matchStartLimit)
+        {
+            uint32_t sequence = read32(source + position);
+            uint32_t &slot = table[hashSequence(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)(position + 1);
+            if (candidate == 0 || position + 1 - candidate > LZ4_MAX_OFFSET || read32(source + candidate - 1) != sequence)
+            {
+                position++;
+                continue;
+            }
+            candidate--;
+            size_t length = LZ4_MIN_MATCH;
+            while (position + length < matchEndLimit && source[candidate + length] == source[position + length])
+                length++;
+            out = writeSequence(out, source + anchor, position - anchor, position - candidate, length);
+            position += length;
+            anchor = position;
+        }
+    }
+    out = writeSequence(out, source + anchor, size - anchor, 0, 0);
+    compressed.resize(out - compressed.data());
+}
+
+// decompresses a block into exactly size bytes of destination. false for a malformed block, nothing is read or
+// written outside the buffers either way
+bool lz4Decompress(const unsigned char *source, size_t sourceSize, unsigned char *destination, size_t size)
+{
+    size_t in = 0, out = 0;
+    auto readLength = [&](size_t &length) {
+        unsigned char byte;
+        do
+        {
+            if (in >= sourceSize)
+                return false;
+            byte = source[in++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+    while (in < sourceSize)
+    {
+        unsigned char token = source[in++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength))
+            return false;
+        if (literalLength > sourceSize - in || literalLength > size - out)
+            return false;
+        memcpy(destination + out, source + in, literalLength);
+        in += literalLength;
+        out += literalLength;
+        // the last sequence has no match
+        if (in == sourceSize)
+            break;
+
+        if (sourceSize - in < 2)
+            return false;
+        size_t offset = source[in] | (size_t)source[in + 1] << 8;
+        in += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength))
+            return false;
+        matchLength += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > out || matchLength > size - out)
+            return false;
+        // matches may overlap what they write, copy forward a byte at a time
+        const unsigned char *match = destination + out - offset;
+        for (size_t i = 0; i < matchLength; i++)
+            destination[out + i] = match[i];
+        out += matchLength;
+    }
+    return out == size;
+}
+#endif
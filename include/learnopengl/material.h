@@ -0,0 +1,136 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+struct Texture {
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// every texture type has a fixed range of units: the Nth texture of type t is on unit t * MATERIAL_UNITS_PER_TYPE + N - 1,
+// so a sampler points at the same unit for every material and only has to be set once per program.
+// the _array types are GL_TEXTURE_2D_ARRAYs shared by several meshes, which pick their layer with Mesh::textureLayers
+const char *const MATERIAL_TEXTURE_TYPES[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height",
+                                              "texture_diffuse_array", "texture_specular_array", "texture_normal_array",
+                                              "texture_height_array"};
+const unsigned int MATERIAL_TEXTURE_TYPE_COUNT = sizeof(MATERIAL_TEXTURE_TYPES) / sizeof(MATERIAL_TEXTURE_TYPES[0]);
+const unsigned int MATERIAL_FIRST_ARRAY_TYPE = 4;
+// 8 types of 2 units fill the 16 units every GL 3.3 context has for fragment shaders
+const unsigned int MATERIAL_UNITS_PER_TYPE = 2;
+
+struct MaterialBinding {
+    unsigned int unit;
+    unsigned int texture;
+    GLenum target;
+
+    bool operator<(const MaterialBinding &other) const
+    {
+        return unit != other.unit ? unit < other.unit : texture < other.texture;
+    }
+};
+
+// the textures of a mesh resolved to units, immutable once MaterialTable made it. meshes with the same textures
+// share one Material, so comparing pointers tells whether anything has to be bound
+class Material
+{
+public:
+    vector<MaterialBinding> bindings;  // by unit, highest first
+    unsigned int id = 0;               // dense, in the order the materials were first seen
+
+    // binds the textures to their units and leaves unit 0 active, the samplers must have been set with setMaterialSamplers
+    void bind() const
+    {
+        for (const MaterialBinding &binding : bindings)
+        {
+            glActiveTexture(GL_TEXTURE0 + binding.unit);
+            glBindTexture(binding.target, binding.texture);
+        }
+        if (!bindings.empty() && bindings.back().unit != 0)
+            glActiveTexture(GL_TEXTURE0);
+    }
+};
+
+// index of a texture type in MATERIAL_TEXTURE_TYPES, or -1 for types materials don't bind
+int materialTextureType(const string &type)
+{
+    for (unsigned int t = 0; t < MATERIAL_TEXTURE_TYPE_COUNT; t++)
+        if (type == MATERIAL_TEXTURE_TYPES[t])
+            return (int)t;
+    return -1;
+}
+
+// points every sampler prefix + type + N of the program at its unit, samplers the program doesn't have are skipped.
+// call once per program and prefix, after that any Material can be bound for it
+void setMaterialSamplers(Shader &shader, const string &prefix)
+{
+    shader.use();
+    for (unsigned int t = 0; t < MATERIAL_TEXTURE_TYPE_COUNT; t++)
+        for (unsigned int number = 1; number <= MATERIAL_UNITS_PER_TYPE; number++)
+        {
+            GLint location = shader.location(UniformName(prefix + MATERIAL_TEXTURE_TYPES[t] + to_string(number)));
+            if (location != -1)
+                glUniform1i(location, (int)(t * MATERIAL_UNITS_PER_TYPE + number - 1));
+        }
+}
+
+// Every distinct set of bindings the loaded meshes use, resolved once when a mesh is uploaded.
+// materials live as long as the table, which is small next to the textures it points at
+class MaterialTable
+{
+public:
+    static MaterialTable &shared()
+    {
+        static MaterialTable table;
+        return table;
+    }
+
+    // the material of a mesh's textures, numbered within each type in the order they're listed
+    const Material *resolve(const vector<Texture> &textures)
+    {
+        vector<MaterialBinding> bindings;
+        unsigned int numbers[MATERIAL_TEXTURE_TYPE_COUNT] = {};
+        for (const Texture &texture : textures)
+        {
+            int t = materialTextureType(texture.type);
+            if (t == -1 || ++numbers[t] > MATERIAL_UNITS_PER_TYPE)
+            {
+                cout << "ERROR::MATERIAL:: no unit for " << texture.type << " texture " << texture.path << endl;
+                continue;
+            }
+            bindings.push_back(MaterialBinding{t * MATERIAL_UNITS_PER_TYPE + numbers[t] - 1, texture.id,
+                                               (unsigned int)t >= MATERIAL_FIRST_ARRAY_TYPE ? (GLenum)GL_TEXTURE_2D_ARRAY
+                                                                                            : (GLenum)GL_TEXTURE_2D});
+        }
+        // highest unit first, so bind() ends on unit 0 when the material has one
+        sort(bindings.begin(), bindings.end(), [](const MaterialBinding &a, const MaterialBinding &b) { return b < a; });
+
+        auto found = materials.find(bindings);
+        if (found != materials.end())
+            return found->second.get();
+        unique_ptr<Material> material(new Material());
+        material->bindings = bindings;
+        material->id = (unsigned int)materials.size();
+        return materials.emplace(move(bindings), move(material)).first->second.get();
+    }
+
+    size_t size() const
+    {
+        return materials.size();
+    }
+
+private:
+    map<vector<MaterialBinding>, unique_ptr<Material>> materials;
+};
+#endif
@@ -6,9 +6,19 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/geometry_pool.h>
+#include <learnopengl/index_encoding.h>
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <utility>
 #include <vector>
 using namespace std;
 
@@ -27,113 +37,393 @@ struct Vertex {
 
 
 
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// all five attributes of Vertex, bit i stands for attribute location i (see Shader::attributeMask)
+const unsigned int VERTEX_ATTRIBUTES_ALL = 0x1F;
+
+const VertexAttribute FULL_VERTEX_ATTRIBUTES[] = {
+    {0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position),  sizeof(glm::vec3)},
+    {1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal),    sizeof(glm::vec3)},
+    {2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords), sizeof(glm::vec2)},
+    {3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Tangent),   sizeof(glm::vec3)},
+    {4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Bitangent), sizeof(glm::vec3)},
+};
+
+// the tangent frame quaternion stands in for normal, tangent and bitangent. it takes the normal's location 1, where
+// shaders decode it with decodeTangentFrame, so a shader that only reads normals doesn't need a tangent stream
+const VertexAttribute PACKED_VERTEX_ATTRIBUTES[] = {
+    {0, 3, GL_UNSIGNED_SHORT, GL_TRUE,  offsetof(PackedVertex, Position),     sizeof(uint16_t) * 4},
+    {1, 4, GL_BYTE,           GL_TRUE,  offsetof(PackedVertex, TangentFrame), sizeof(int8_t) * 4},
+    {2, 2, GL_HALF_FLOAT,     GL_FALSE, offsetof(PackedVertex, TexCoords),    sizeof(uint16_t) * 2},
+};
+
+// axis aligned bounding box and bounding sphere of a mesh in model space
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// the sphere is centered on the box, which is rarely much larger than the smallest sphere for meshes
+Bounds computeBounds(const vector<Vertex> &vertices)
+{
+    Bounds bounds;
+    if (vertices.empty())
+        return bounds;
+    bounds.min = bounds.max = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (const Vertex &vertex : vertices)
+    {
+        glm::vec3 offset = vertex.Position - bounds.center;
+        radiusSquared = max(radiusSquared, glm::dot(offset, offset));
+    }
+    bounds.radius = sqrt(radiusSquared);
+    return bounds;
+}
+
+// simplified index buffer over the vertices of its mesh (see generateMeshLods).
+// error is how far the surface moved, relative to the radius of the mesh's bounding sphere
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error = 0.0f;
+};
+
+// a level of detail as uploaded, it shares the vertices (and so the base vertex) of the full mesh
+struct MeshLodLevel {
+    GeometryAllocation geometry;
+    unsigned int triangleCount = 0;
+    float error = 0.0f;
+};
+
+// how far a level may move the surface on screen, in pixels, before a finer level is picked
+const float LOD_PIXEL_ERROR = 1.0f;
+// a coarser level is only picked once its error is this much below the limit, so meshes don't flicker between levels
+const float LOD_HYSTERESIS = 0.25f;
+
+// what LOD selection needs to know about the view
+struct LodContext {
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 1.0f;  // projected size in pixels of one unit at distance one
+    float bias = 0.0f;           // each step doubles the tolerated error, negative values favour detail
+
+    static LodContext perspective(const glm::vec3 &viewPosition, float fovy, float viewportHeight, float bias)
+    {
+        LodContext context;
+        context.viewPosition = viewPosition;
+        context.pixelsPerUnit = viewportHeight / (2.0f * tan(fovy * 0.5f));
+        context.bias = bias;
+        return context;
+    }
+
+    // radius on screen in pixels of a world space bounding sphere. inside the sphere the mesh covers the screen
+    float radiusPixels(const glm::vec3 &center, float radius) const
+    {
+        float distance = glm::length(center - viewPosition) - radius;
+        return distance > 0.0f ? radius / distance * pixelsPerUnit : numeric_limits<float>::max();
+    }
+};
+
+// the largest axis scale of a model matrix, makes bounding spheres conservative for non uniformly scaled models
+float maxAxisScale(const glm::mat4 &model)
+{
+    return sqrt(max(max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])), glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))),
+                    glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+}
+
+// picks the level to draw from the radius of a mesh on screen in pixels, current is the level it was drawn with last.
+// the finest level whose error fits the limit is picked, but a mesh only moves to a coarser level once that level's
+// error is clearly below the limit
+unsigned int selectLodLevel(const vector<MeshLodLevel> &lods, unsigned int current, float radiusPixels, float bias)
+{
+    float limit = LOD_PIXEL_ERROR * exp2(bias);
+    unsigned int selected = 0;
+    while (selected < lods.size() && lods[selected].error * radiusPixels <= limit)
+        selected++;
+    if (selected > current)
+    {
+        // coarser: step only as far as the levels that are below the limit with some margin
+        unsigned int coarser = current;
+        while (coarser < selected && lods[coarser].error * radiusPixels <= limit * (1.0f - LOD_HYSTERESIS))
+            coarser++;
+        selected = coarser;
+    }
+    return selected;
+}
+
+// the per mesh uniforms DrawGeometry sets, resolved once per program (see RenderQueue::useProgram) so drawing a mesh
+// doesn't look any of them up by name
+struct MeshUniforms {
+    Uniform<bool> packedVertices;
+    Uniform<glm::vec4> textureLayers;
+    Uniform<glm::vec3> positionScale;
+    Uniform<glm::vec3> positionOffset;
+
+    MeshUniforms() {}
+
+    explicit MeshUniforms(const Shader &shader)
+        : packedVertices(shader.uniform<bool>("packedVertices")), textureLayers(shader.uniform<glm::vec4>("textureLayers")),
+          positionScale(shader.uniform<glm::vec3>("positionScale")), positionOffset(shader.uniform<glm::vec3>("positionOffset"))
+    {
+    }
+};
+
+// CPU side description of a mesh, as produced by the importer (or read back from the mesh cache) before it is uploaded.
+// texture ids are not known at this point, only the type and the path of each texture.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    Bounds               bounds;
+    vector<MeshLod>      lods;  // coarser levels, from fine to coarse
+};
+
+// how a mesh is laid out on the GPU
+struct MeshOptions {
+    VertexFormat format = VERTEX_FORMAT_FULL;
+    unsigned int attributeMask = VERTEX_ATTRIBUTES_ALL;  // usually Shader::attributeMask
+    bool indexStrips = false;  // upload triangle strips with primitive restart when they are smaller than the list
+    bool keepCpuData = false;  // keep vertices and indices in RAM after the upload, for collision or picking
 };
 
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, vertices and indices are empty once uploaded unless MeshOptions::keepCpuData is set
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Bounds               bounds;
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
-    {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+    unsigned int VAO;                // shared by all meshes with the same vertex layout, see GeometryPool
+    GeometryAllocation geometry;
+    vector<MeshLodLevel> lods;       // coarser levels, lod 0 is the full mesh and lod i draws lods[i - 1]
+    unsigned int lod = 0;
+    bool visible = true;             // set by Model::Cull, invisible meshes are skipped by Model::Draw
+    std::string glslIdentifierPrefix;  // of the sampler names, e.g. "material." for material.texture_diffuse1
+    const Material *material = nullptr;  // the textures resolved to their units, see MaterialTable
+    // layer of the diffuse, specular, normal and height texture in its texture array, -1 for the ones that aren't in one
+    glm::vec4 textureLayers = glm::vec4(-1.0f);
+    VertexFormat vertexFormat;
+    unsigned int attributeMask;  // attribute locations that are uploaded, the rest stay disabled
+    bool indexStrips;
+    // decodes packed positions in the vertex shader, position = packed * positionScale + positionOffset
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // constructor, options.attributeMask selects the vertex streams that are uploaded.
+    // pass the vectors with std::move, they are uploaded straight from the moved in storage
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const MeshOptions &options = MeshOptions())
+    {
+        this->vertices = move(vertices);
+        this->indices = move(indices);
+        this->textures = move(textures);
+        bounds = computeBounds(this->vertices);
+        setup(options);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // takes over the data of an imported mesh, including its bounds
+    Mesh(MeshData &&data, const MeshOptions &options = MeshOptions())
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        vertices = move(data.vertices);
+        indices = move(data.indices);
+        textures = move(data.textures);
+        bounds = data.bounds;
+        setup(options);
+
+        for (const MeshLod &level : data.lods)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            EncodedIndices encoded;
+            encodeIndices(level.indices, vertexCount, indexStrips, encoded);
+            MeshLodLevel uploaded;
+            uploaded.geometry = GeometryPool::shared().allocateIndices(geometry, encoded);
+            uploaded.triangleCount = (unsigned int)(level.indices.size() / 3);
+            uploaded.error = level.error;
+            lods.push_back(uploaded);
         }
+        vector<MeshLod>().swap(data.lods);
+    }
 
+    // picks the level to draw from the radius of the mesh on screen in pixels, see selectLodLevel
+    void selectLod(float radiusPixels, float bias)
+    {
+        lod = selectLodLevel(lods, lod, radiusPixels, bias);
+    }
 
+    unsigned int lodTriangleCount() const
+    {
+        return levelTriangleCount(lod);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    unsigned int levelTriangleCount(unsigned int level) const
+    {
+        return level ? lods[level - 1].triangleCount : (unsigned int)triangleCount;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // render the mesh. bindVertexArray can be false when the caller has already bound VAO (see Model::Draw).
+    // the shader's samplers must already point at the material units, setMaterialSamplers does that once per program
+    void Draw(Shader &shader, bool bindVertexArray = true)
+    {
+        BindTextures();
+        if (bindVertexArray)
+            glBindVertexArray(VAO);
+        DrawGeometry(MeshUniforms(shader));
+        if (bindVertexArray)
+            glBindVertexArray(0);
+    }
+
+    // binds the textures to their units, the samplers must already point at them (see setMaterialSamplers)
+    void BindTextures() const
+    {
+        material->bind();
+    }
+
+    // the allocation of the selected level of detail
+    const GeometryAllocation &drawnGeometry() const
+    {
+        return levelGeometry(lod);
+    }
+
+    const GeometryAllocation &levelGeometry(unsigned int level) const
+    {
+        return level ? lods[level - 1].geometry : geometry;
+    }
+
+    // draws the selected level of detail with whatever textures are bound, the mesh's VAO must be bound and uniforms
+    // resolved on the program in use
+    void DrawGeometry(const MeshUniforms &uniforms) const
+    {
+        DrawGeometry(uniforms, lod, 1);
+    }
+
+    // draws a level of detail instances times, the copies tell themselves apart by per instance attributes
+    // (see InstanceBuffer) or gl_InstanceID
+    void DrawGeometry(const MeshUniforms &uniforms, unsigned int level, GLsizei instances) const
+    {
+        uniforms.packedVertices.set(vertexFormat == VERTEX_FORMAT_PACKED);
+        uniforms.textureLayers.set(textureLayers);
+        if (vertexFormat == VERTEX_FORMAT_PACKED)
+        {
+            uniforms.positionScale.set(positionScale);
+            uniforms.positionOffset.set(positionOffset);
+        }
+
+        // draw mesh, its vertices and indices sit somewhere in the shared buffers of its layout.
+        // index width and primitive are whatever encodeIndices picked for this mesh
+        const GeometryAllocation &drawn = levelGeometry(level);
+        if (drawn.primitive == GL_TRIANGLE_STRIP)
+        {
+            glEnable(GL_PRIMITIVE_RESTART);
+            glPrimitiveRestartIndex(drawn.indexType == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF);
+        }
+        if (instances == 1)
+            glDrawElementsBaseVertex(drawn.primitive, drawn.indexCount, drawn.indexType,
+                                     (void*)drawn.indexOffset, drawn.firstVertex);
+        else
+            glDrawElementsInstancedBaseVertex(drawn.primitive, drawn.indexCount, drawn.indexType,
+                                              (void*)drawn.indexOffset, instances, drawn.firstVertex);
+        if (drawn.primitive == GL_TRIANGLE_STRIP)
+            glDisable(GL_PRIMITIVE_RESTART);
     }
 
 private:
-    // render data
-    unsigned int VBO, EBO;
+    void setup(const MeshOptions &options)
+    {
+        material = MaterialTable::shared().resolve(textures);
+        vertexFormat = options.format;
+        attributeMask = options.attributeMask;
+        indexStrips = options.indexStrips;
+        vertexCount = vertices.size();
+        triangleCount = indices.size() / 3;
 
-    // initializes all the buffer objects/arrays
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        setupMesh();
+
+        // the GPU has its own copy now, only bounds and counts stay around
+        if (!options.keepCpuData)
+        {
+            vector<Vertex>().swap(vertices);
+            vector<unsigned int>().swap(indices);
+        }
+    }
+
+    // copies the vertices into the GeometryPool, in the layout their format and attribute mask ask for,
+    // and the indices in the smallest encoding that fits
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        vector<unsigned char> stream;
+        VertexLayout layout;
+        if (vertexFormat == VERTEX_FORMAT_PACKED)
+        {
+            vector<PackedVertex> packed = packVertices();
+            // the tangent frame quaternion carries the tangent and bitangent too
+            unsigned int tangentSpace = (1u << 1) | (1u << 3) | (1u << 4);
+            buildVertexStream(packed, PACKED_VERTEX_ATTRIBUTES, sizeof(PACKED_VERTEX_ATTRIBUTES) / sizeof(VertexAttribute),
+                              attributeMask & tangentSpace ? attributeMask | (1u << 1) : attributeMask, stream, layout);
+        }
+        else
+            buildVertexStream(vertices, FULL_VERTEX_ATTRIBUTES, sizeof(FULL_VERTEX_ATTRIBUTES) / sizeof(VertexAttribute),
+                              attributeMask, stream, layout);
+
+        EncodedIndices encoded;
+        encodeIndices(indices, vertices.size(), indexStrips, encoded);
+        geometry = GeometryPool::shared().allocate(layout, stream.data(), vertices.size(), encoded);
+        VAO = geometry.VAO;
+    }
+
+    // interleaves the attributes selected by mask, so the stream only holds what the shader reads
+    template <typename T>
+    static void buildVertexStream(const vector<T> &source, const VertexAttribute *attributes, size_t count, unsigned int mask,
+                                  vector<unsigned char> &stream, VertexLayout &layout)
+    {
+        layout.stride = 0;
+        layout.attributes.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!(mask & (1u << attributes[i].location)))
+                continue;
+            VertexAttribute attribute = attributes[i];
+            attribute.offset = layout.stride;
+            layout.attributes.push_back(attribute);
+            layout.stride += attribute.size;
+        }
+
+        stream.resize(source.size() * layout.stride);
+        for (size_t v = 0; v < source.size(); v++)
+        {
+            const unsigned char *vertex = (const unsigned char *)&source[v];
+            size_t a = 0;
+            for (size_t i = 0; i < count; i++)
+                if (mask & (1u << attributes[i].location))
+                    memcpy(&stream[v * layout.stride + layout.attributes[a++].offset], vertex + attributes[i].offset, attributes[i].size);
+        }
+    }
+
+    // quantizes the vertices to PackedVertex, positions relative to the mesh's bounding box
+    vector<PackedVertex> packVertices()
+    {
+        glm::vec3 low(0.0f), high(0.0f);
+        if (!vertices.empty())
+            low = high = vertices[0].Position;
+        for (const Vertex &vertex : vertices)
+        {
+            low = glm::min(low, vertex.Position);
+            high = glm::max(high, vertex.Position);
+        }
+        packedPositionRange(low, high, positionScale, positionOffset);
+
+        vector<PackedVertex> packed;
+        packed.reserve(vertices.size());
+        for (const Vertex &vertex : vertices)
+            packed.push_back(packVertex(vertex.Position, vertex.Normal, vertex.TexCoords, vertex.Tangent, vertex.Bitangent,
+                                        positionScale, positionOffset));
+        return packed;
     }
 };
 #endif
\ No newline at end of file
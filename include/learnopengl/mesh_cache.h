@@ -0,0 +1,341 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/vfs.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// bump whenever the layout of the file or the way meshes are processed before they are cached changes
+const uint32_t MESH_CACHE_VERSION = 6;
+const char * const MESH_CACHE_DIRECTORY = "resources/cache";
+const char MESH_CACHE_MAGIC[8] = "LOGLMSH";
+
+// counters for Model::loadModel, so the cache hit rate and the time spent loading can be inspected
+struct ModelLoadStats {
+    unsigned int cacheHits = 0;
+    unsigned int cacheMisses = 0;
+    double cacheMilliseconds = 0.0;   // time spent loading models that were found in the cache
+    double importMilliseconds = 0.0;  // time spent importing models through assimp (and writing them to the cache)
+
+    float hitRate() const
+    {
+        unsigned int loads = cacheHits + cacheMisses;
+        return loads ? (float)cacheHits / (float)loads : 0.0f;
+    }
+};
+
+ModelLoadStats &modelLoadStats()
+{
+    static ModelLoadStats stats;
+    return stats;
+}
+
+// Binary cache of fully processed meshes. One file per source model, laid out so it can be mapped and read in place:
+//
+//   MeshCacheHeader
+//   MeshCacheEntry[meshCount]
+//   MeshCacheTexture[textureCount]
+//   MeshCacheLod[lodCount]
+//   string data (texture types and paths)
+//   per mesh: Vertex[vertexCount], unsigned int[indexCount], then the indices of each LOD (each array 16 byte aligned)
+//
+// the key stored in the header covers the source path, its size and modification time, the assimp import flags,
+// the cache version and the size of Vertex; a cache file whose key doesn't match is ignored and rewritten.
+class MeshCache
+{
+public:
+    static bool load(const string &path, unsigned int importFlags, vector<MeshData> &meshes)
+    {
+        uint64_t key;
+        if (!computeKey(path, importFlags, key))
+            return false;
+
+        string cachePath = getCachePath(path);
+        int fd = open(cachePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        size_t size = (size_t)st.st_size;
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        bool ok = deserialize((const unsigned char *)mapping, size, key, meshes);
+        munmap(mapping, size);
+        if (!ok)
+            meshes.clear();
+        return ok;
+    }
+
+    static bool store(const string &path, unsigned int importFlags, const vector<MeshData> &meshes)
+    {
+        uint64_t key;
+        if (!computeKey(path, importFlags, key))
+            return false;
+
+        vector<unsigned char> file;
+        serialize(key, meshes, file);
+
+        // write to a temporary file first and rename it, so a crash never leaves a truncated cache file behind
+        mkdir(MESH_CACHE_DIRECTORY, 0755);
+        string cachePath = getCachePath(path);
+        string tmpPath = cachePath + ".tmp";
+        FILE *out = fopen(tmpPath.c_str(), "wb");
+        if (!out)
+        {
+            cout << "ERROR::MESH_CACHE:: Failed to open " << tmpPath << " for writing" << endl;
+            return false;
+        }
+        bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            cout << "ERROR::MESH_CACHE:: Failed to write " << cachePath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct MeshCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t meshCount;
+        uint64_t key;
+        uint32_t textureCount;
+        uint32_t stringBytes;
+        uint32_t lodCount;
+        uint32_t reserved;
+    };
+
+    struct MeshCacheEntry {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t firstTexture;
+        uint32_t textureCount;
+        uint32_t firstLod;
+        uint32_t lodCount;
+        float boundsMin[3];
+        float boundsMax[3];
+        float sphereCenter[3];
+        float sphereRadius;
+    };
+
+    struct MeshCacheLod {
+        uint64_t indexOffset;
+        uint32_t indexCount;
+        float error;
+    };
+
+    struct MeshCacheTexture {
+        uint32_t typeOffset, typeLength;
+        uint32_t pathOffset, pathLength;
+    };
+
+    static size_t align(size_t offset)
+    {
+        return (offset + 15) & ~(size_t)15;
+    }
+
+    // the model file's size and stamp come from the VirtualFileSystem, so a packed model is keyed by its contents
+    static bool computeKey(const string &path, unsigned int importFlags, uint64_t &key)
+    {
+        uint64_t size, stamp;
+        if (!VirtualFileSystem::shared().describe(path, size, stamp))
+            return false;
+        uint64_t fields[] = {
+            size,
+            stamp,
+            (uint64_t)importFlags,
+            (uint64_t)MESH_CACHE_VERSION,
+            (uint64_t)sizeof(Vertex)
+        };
+        key = fnv1a64(fields, sizeof(fields), fnv1a64(path.data(), path.size()));
+        return true;
+    }
+
+    static string getCachePath(const string &path)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)fnv1a64(path.data(), path.size()));
+        return string(MESH_CACHE_DIRECTORY) + '/' + name;
+    }
+
+    static void serialize(uint64_t key, const vector<MeshData> &meshes, vector<unsigned char> &file)
+    {
+        vector<MeshCacheEntry> entries(meshes.size());
+        vector<MeshCacheTexture> textures;
+        vector<MeshCacheLod> lods;
+        string strings;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            entries[i].firstLod = (uint32_t)lods.size();
+            entries[i].lodCount = (uint32_t)meshes[i].lods.size();
+            lods.resize(lods.size() + meshes[i].lods.size());
+            entries[i].firstTexture = (uint32_t)textures.size();
+            entries[i].textureCount = (uint32_t)meshes[i].textures.size();
+            for (const Texture &texture : meshes[i].textures)
+            {
+                MeshCacheTexture record;
+                record.typeOffset = (uint32_t)strings.size();
+                record.typeLength = (uint32_t)texture.type.size();
+                strings += texture.type;
+                record.pathOffset = (uint32_t)strings.size();
+                record.pathLength = (uint32_t)texture.path.size();
+                strings += texture.path;
+                textures.push_back(record);
+            }
+        }
+
+        size_t offset = sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry)
+                      + textures.size() * sizeof(MeshCacheTexture) + lods.size() * sizeof(MeshCacheLod) + strings.size();
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            MeshCacheEntry &entry = entries[i];
+            entry.vertexCount = (uint32_t)mesh.vertices.size();
+            entry.indexCount = (uint32_t)mesh.indices.size();
+            entry.vertexOffset = align(offset);
+            offset = entry.vertexOffset + mesh.vertices.size() * sizeof(Vertex);
+            entry.indexOffset = align(offset);
+            offset = entry.indexOffset + mesh.indices.size() * sizeof(unsigned int);
+            for (size_t l = 0; l < mesh.lods.size(); l++)
+            {
+                MeshCacheLod &lod = lods[entry.firstLod + l];
+                lod.indexCount = (uint32_t)mesh.lods[l].indices.size();
+                lod.error = mesh.lods[l].error;
+                lod.indexOffset = align(offset);
+                offset = lod.indexOffset + mesh.lods[l].indices.size() * sizeof(unsigned int);
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                entry.boundsMin[c] = mesh.bounds.min[c];
+                entry.boundsMax[c] = mesh.bounds.max[c];
+                entry.sphereCenter[c] = mesh.bounds.center[c];
+            }
+            entry.sphereRadius = mesh.bounds.radius;
+        }
+
+        MeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.meshCount = (uint32_t)meshes.size();
+        header.key = key;
+        header.textureCount = (uint32_t)textures.size();
+        header.stringBytes = (uint32_t)strings.size();
+        header.lodCount = (uint32_t)lods.size();
+
+        file.assign(offset, 0);
+        unsigned char *out = file.data();
+        memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        if (!entries.empty())
+            memcpy(out, entries.data(), entries.size() * sizeof(MeshCacheEntry));
+        out += entries.size() * sizeof(MeshCacheEntry);
+        if (!textures.empty())
+            memcpy(out, textures.data(), textures.size() * sizeof(MeshCacheTexture));
+        out += textures.size() * sizeof(MeshCacheTexture);
+        if (!lods.empty())
+            memcpy(out, lods.data(), lods.size() * sizeof(MeshCacheLod));
+        out += lods.size() * sizeof(MeshCacheLod);
+        memcpy(out, strings.data(), strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            if (!meshes[i].vertices.empty())
+                memcpy(file.data() + entries[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+            if (!meshes[i].indices.empty())
+                memcpy(file.data() + entries[i].indexOffset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+            for (size_t l = 0; l < meshes[i].lods.size(); l++)
+                memcpy(file.data() + lods[entries[i].firstLod + l].indexOffset, meshes[i].lods[l].indices.data(),
+                       meshes[i].lods[l].indices.size() * sizeof(unsigned int));
+        }
+    }
+
+    static bool deserialize(const unsigned char *data, size_t size, uint64_t key, vector<MeshData> &meshes)
+    {
+        const MeshCacheHeader *header = (const MeshCacheHeader *)data;
+        if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != MESH_CACHE_VERSION || header->key != key)
+            return false;
+
+        size_t tableBytes = sizeof(MeshCacheHeader) + (size_t)header->meshCount * sizeof(MeshCacheEntry)
+                          + (size_t)header->textureCount * sizeof(MeshCacheTexture)
+                          + (size_t)header->lodCount * sizeof(MeshCacheLod) + header->stringBytes;
+        if (tableBytes > size)
+            return false;
+        const MeshCacheEntry *entries = (const MeshCacheEntry *)(data + sizeof(MeshCacheHeader));
+        const MeshCacheTexture *textures = (const MeshCacheTexture *)(entries + header->meshCount);
+        const MeshCacheLod *lods = (const MeshCacheLod *)(textures + header->textureCount);
+        const char *strings = (const char *)(lods + header->lodCount);
+
+        meshes.resize(header->meshCount);
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheEntry &entry = entries[i];
+            if (entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(Vertex) > size
+                || entry.indexOffset + (uint64_t)entry.indexCount * sizeof(unsigned int) > size
+                || (uint64_t)entry.firstTexture + entry.textureCount > header->textureCount
+                || (uint64_t)entry.firstLod + entry.lodCount > header->lodCount)
+                return false;
+
+            MeshData &mesh = meshes[i];
+            const Vertex *vertices = (const Vertex *)(data + entry.vertexOffset);
+            const unsigned int *indices = (const unsigned int *)(data + entry.indexOffset);
+            mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+            mesh.indices.assign(indices, indices + entry.indexCount);
+            mesh.lods.resize(entry.lodCount);
+            for (uint32_t l = 0; l < entry.lodCount; l++)
+            {
+                const MeshCacheLod &lod = lods[entry.firstLod + l];
+                if (lod.indexOffset + (uint64_t)lod.indexCount * sizeof(unsigned int) > size)
+                    return false;
+                const unsigned int *lodIndices = (const unsigned int *)(data + lod.indexOffset);
+                mesh.lods[l].indices.assign(lodIndices, lodIndices + lod.indexCount);
+                mesh.lods[l].error = lod.error;
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                mesh.bounds.min[c] = entry.boundsMin[c];
+                mesh.bounds.max[c] = entry.boundsMax[c];
+                mesh.bounds.center[c] = entry.sphereCenter[c];
+            }
+            mesh.bounds.radius = entry.sphereRadius;
+            for (uint32_t t = 0; t < entry.textureCount; t++)
+            {
+                const MeshCacheTexture &record = textures[entry.firstTexture + t];
+                if ((uint64_t)record.typeOffset + record.typeLength > header->stringBytes
+                    || (uint64_t)record.pathOffset + record.pathLength > header->stringBytes)
+                    return false;
+                Texture texture;
+                texture.id = 0;
+                texture.type.assign(strings + record.typeOffset, record.typeLength);
+                texture.path.assign(strings + record.pathOffset, record.pathLength);
+                mesh.textures.push_back(texture);
+            }
+        }
+        return true;
+    }
+};
+#endif
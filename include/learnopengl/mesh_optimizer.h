@@ -0,0 +1,317 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// size of the post transform cache the orderings are tuned for (and that ACMR is measured with)
+const unsigned int VERTEX_CACHE_SIZE = 32;
+// how much worse than the vertex cache order the overdraw order may make ACMR
+const float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+// before and after numbers of optimizeMesh, summed up over the meshes of a model
+struct MeshOptimizationStats {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t triangles = 0;
+    size_t missesBefore = 0;
+    size_t missesAfter = 0;
+
+    // average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal for regular grids and 3 the worst case
+    float acmrBefore() const
+    {
+        return triangles ? (float)missesBefore / triangles : 0.0f;
+    }
+
+    float acmrAfter() const
+    {
+        return triangles ? (float)missesAfter / triangles : 0.0f;
+    }
+};
+
+// number of vertex shader invocations for the index buffer on a FIFO post transform cache of the given size
+size_t simulateVertexCache(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    vector<size_t> cachedAt(vertexCount, 0); // time the vertex entered the cache, + 1
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (cachedAt[index] == 0 || misses - (cachedAt[index] - 1) >= cacheSize)
+        {
+            cachedAt[index] = misses + 1;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+// joins vertices that are bitwise identical and rewrites the indices to match
+void weldVertices(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    size_t capacity = 1;
+    while (capacity < vertices.size() * 2)
+        capacity *= 2;
+    const unsigned int empty = ~0u;
+    vector<unsigned int> table(capacity, empty);  // open addressing, holds indices into welded
+
+    vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        size_t slot = hashBytes(&vertices[i], sizeof(Vertex)) & (capacity - 1);
+        while (table[slot] != empty && memcmp(&welded[table[slot]], &vertices[i], sizeof(Vertex)) != 0)
+            slot = (slot + 1) & (capacity - 1);
+        if (table[slot] == empty)
+        {
+            table[slot] = (unsigned int)welded.size();
+            welded.push_back(vertices[i]);
+        }
+        remap[i] = table[slot];
+    }
+    for (unsigned int &index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+// Reorders triangles for the post transform vertex cache, after Tom Forsyth's "Linear-Speed Vertex Cache Optimisation":
+// vertices are scored by their position in a simulated LRU cache and by how many triangles still use them,
+// and the triangle with the best score among those touching the cache is emitted next.
+void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int cacheSize = (int)VERTEX_CACHE_SIZE;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles using each vertex, as offsets into one array
+    vector<unsigned int> valence(vertexCount, 0);
+    for (unsigned int index : indices)
+        valence[index]++;
+    vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    auto vertexScore = [cacheSize](int cachePosition, unsigned int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            // the last triangle's vertices get a fixed score, so the next triangle doesn't simply reuse the same edge
+            score = cachePosition < 3 ? 0.75f : pow(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), 1.5f);
+        // prefer vertices with few triangles left, to get rid of lone triangles early
+        return score + 2.0f * pow((float)remaining, -0.5f);
+    };
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, valence[v]);
+    vector<float> triangleScore(triangleCount);
+    vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    vector<unsigned int> cache, nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    size_t cursor = 0;  // for when nothing in the cache has triangles left
+    int best = (int)(max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        const unsigned int *triangle = &indices[best * 3];
+        nextCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = triangle[k];
+            // remove the triangle from the vertex's list of remaining triangles
+            unsigned int *first = &adjacency[adjacencyOffset[v]], *last = first + valence[v];
+            *find(first, last, (unsigned int)best) = *(last - 1);
+            valence[v]--;
+        }
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                nextCache.push_back(v);
+        cache.swap(nextCache);
+
+        // rescore the cached vertices (and the ones that just dropped out) and their triangles
+        for (int i = 0; i < (int)cache.size(); i++)
+        {
+            unsigned int v = cache[i];
+            cachePosition[v] = i < cacheSize ? i : -1;
+            float newScore = vertexScore(cachePosition[v], valence[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + valence[v]; a++)
+                triangleScore[adjacency[a]] += delta;
+        }
+        if (cache.size() > (size_t)cacheSize)
+            cache.resize(cacheSize);
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : cache)
+        {
+            for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v] + valence[v]; a++)
+            {
+                unsigned int t = adjacency[a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (int)t;
+                }
+            }
+        }
+
+        if (best < 0)
+        {
+            while (cursor < triangleCount && emitted[cursor])
+                cursor++;
+            best = cursor < triangleCount ? (int)cursor : -1;
+        }
+        result.insert(result.end(), triangle, triangle + 3);
+    }
+    indices.swap(result);
+}
+
+// Reorders clusters of triangles so the ones facing outwards come first, after Sander et al.'s "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw". Meant to run after optimizeVertexCache: clusters are split where the cache
+// order has to restart anyway, so the cache efficiency stays within threshold of the input's.
+void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices, float threshold = OVERDRAW_ACMR_THRESHOLD)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // a new cluster starts at every triangle whose vertices are all cache misses, and at any miss once the cluster
+    // is big enough and its own miss ratio is within threshold of the whole mesh's
+    const size_t MIN_CLUSTER_TRIANGLES = 64;
+    float acmr = (float)simulateVertexCache(indices, vertices.size()) / triangleCount;
+    vector<size_t> clusters;
+    {
+        vector<size_t> cachedAt(vertices.size(), 0);
+        size_t misses = 0, clusterMisses = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int triangleMisses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[t * 3 + k];
+                if (cachedAt[index] == 0 || misses - (cachedAt[index] - 1) >= VERTEX_CACHE_SIZE)
+                {
+                    cachedAt[index] = misses + 1;
+                    misses++;
+                    triangleMisses++;
+                }
+            }
+            size_t clusterTriangles = clusters.empty() ? 0 : t - clusters.back();
+            bool soft = triangleMisses > 0 && clusterTriangles >= MIN_CLUSTER_TRIANGLES
+                        && (float)clusterMisses / clusterTriangles <= acmr * threshold;
+            if (t == 0 || triangleMisses == 3 || soft)
+            {
+                clusters.push_back(t);
+                clusterMisses = 0;
+            }
+            clusterMisses += triangleMisses;
+        }
+    }
+    if (clusters.size() < 2)
+        return;
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    struct Cluster {
+        size_t first, count;
+        float sortKey;
+    };
+    vector<Cluster> order(clusters.size());
+    vector<glm::vec3> centers(clusters.size()), normals(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        size_t first = clusters[c], end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = first; t < end; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(n);
+            center = center + (a + b + d) * (triangleArea / 3.0f);
+            normal = normal + n;
+            area += triangleArea;
+        }
+        meshCenter = meshCenter + center;
+        meshArea += area;
+        centers[c] = area > 0.0f ? center / area : vertices[indices[first * 3]].Position;
+        normals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+        order[c] = {first, end - first, 0.0f};
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+    // clusters far out along their normal occlude the others, draw them first
+    for (size_t c = 0; c < clusters.size(); c++)
+        order[c].sortKey = glm::dot(centers[c] - meshCenter, normals[c]);
+    stable_sort(order.begin(), order.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster &cluster : order)
+        result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+    if (simulateVertexCache(result, vertices.size()) <= simulateVertexCache(indices, vertices.size()) * threshold)
+        indices.swap(result);
+}
+
+// renumbers vertices in the order the index buffer first uses them, so vertex fetches walk memory forward.
+// vertices no index refers to are dropped.
+void optimizeVertexFetch(vector<Vertex> &vertices, vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int &index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+// runs all the passes on a freshly imported mesh and adds the before/after numbers to stats
+void optimizeMesh(MeshData &mesh, MeshOptimizationStats &stats)
+{
+    stats.verticesBefore += mesh.vertices.size();
+    stats.triangles += mesh.indices.size() / 3;
+    stats.missesBefore += simulateVertexCache(mesh.indices, mesh.vertices.size());
+
+    weldVertices(mesh.vertices, mesh.indices);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size());
+    optimizeOverdraw(mesh.indices, mesh.vertices);
+    optimizeVertexFetch(mesh.vertices, mesh.indices);
+
+    stats.verticesAfter += mesh.vertices.size();
+    stats.missesAfter += simulateVertexCache(mesh.indices, mesh.vertices.size());
+}
+#endif
@@ -0,0 +1,246 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+using namespace std;
+
+// levels generated per mesh (on top of the full mesh), each aiming at half the triangles of the previous one
+const int MESH_LOD_LEVELS = 3;
+// meshes below this don't get levels, there is nothing to gain from them
+const size_t MESH_LOD_MIN_TRIANGLES = 64;
+// a level is only kept when it has at most this fraction of the previous level's triangles
+const float MESH_LOD_MIN_REDUCTION = 0.8f;
+// largest error a level may have, relative to the mesh radius
+const float MESH_LOD_MAX_ERROR = 0.25f;
+
+// symmetric 4x4 matrix summing squared distances to a set of planes, weighted by the area of their triangles
+struct Quadric {
+    float a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    float b0 = 0, b1 = 0, b2 = 0, c = 0;
+    float weight = 0;
+
+    void addPlane(const glm::vec3 &normal, float distance, float weight)
+    {
+        a00 += weight * normal.x * normal.x; a01 += weight * normal.x * normal.y; a02 += weight * normal.x * normal.z;
+        a11 += weight * normal.y * normal.y; a12 += weight * normal.y * normal.z; a22 += weight * normal.z * normal.z;
+        b0 += weight * normal.x * distance; b1 += weight * normal.y * distance; b2 += weight * normal.z * distance;
+        c += weight * distance * distance;
+        this->weight += weight;
+    }
+
+    void add(const Quadric &other)
+    {
+        a00 += other.a00; a01 += other.a01; a02 += other.a02; a11 += other.a11; a12 += other.a12; a22 += other.a22;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2; c += other.c;
+        weight += other.weight;
+    }
+
+    // weighted mean of the squared distances of p to the planes
+    float error(const glm::vec3 &p) const
+    {
+        float rx = a00 * p.x + a01 * p.y + a02 * p.z + b0;
+        float ry = a01 * p.x + a11 * p.y + a12 * p.z + b1;
+        float rz = a02 * p.x + a12 * p.y + a22 * p.z + b2;
+        float sum = fabs(rx * p.x + ry * p.y + rz * p.z + b0 * p.x + b1 * p.y + b2 * p.z + c);
+        return weight > 0.0f ? sum / weight : 0.0f;
+    }
+};
+
+// Simplifies a triangle list with quadric error metric edge collapses until it has at most targetIndexCount indices,
+// or until the next collapse would move the surface further than maxError. The vertices aren't changed, a collapse
+// moves one vertex onto the other end of the edge, so the result indexes the same vertex buffer.
+// vertices on open borders and on attribute seams (the same position under several indices) never move.
+// returns the largest error introduced, as a distance in model space.
+float simplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices, size_t targetIndexCount, float maxError,
+                   vector<unsigned int> &result)
+{
+    size_t vertexCount = vertices.size();
+    result = indices;
+
+    // seams: positions used by more than one vertex
+    vector<bool> locked(vertexCount, false);
+    vector<unsigned int> order(vertexCount);
+    iota(order.begin(), order.end(), 0u);
+    auto lessPosition = [&](unsigned int a, unsigned int b) {
+        const glm::vec3 &p = vertices[a].Position, &q = vertices[b].Position;
+        return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+    };
+    sort(order.begin(), order.end(), lessPosition);
+    for (size_t i = 1; i < vertexCount; i++)
+        if (vertices[order[i]].Position == vertices[order[i - 1]].Position)
+            locked[order[i]] = locked[order[i - 1]] = true;
+
+    // borders: edges that only one triangle uses
+    vector<unsigned int> adjacencyOffset, adjacency;
+    auto buildAdjacency = [&]() {
+        adjacencyOffset.assign(vertexCount + 1, 0);
+        for (unsigned int index : result)
+            adjacencyOffset[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        adjacency.resize(result.size());
+        vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < result.size() / 3; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[result[t * 3 + k]]++] = (unsigned int)t;
+    };
+    buildAdjacency();
+    for (size_t t = 0; t < result.size() / 3; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+            bool shared = false;
+            for (unsigned int i = adjacencyOffset[b]; i < adjacencyOffset[b + 1] && !shared; i++)
+            {
+                const unsigned int *other = &result[adjacency[i] * 3];
+                for (int j = 0; j < 3; j++)
+                    shared |= other[j] == b && other[(j + 1) % 3] == a;
+            }
+            if (!shared)
+                locked[a] = locked[b] = true;
+        }
+    }
+
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < result.size() / 3; t++)
+    {
+        const glm::vec3 &p0 = vertices[result[t * 3]].Position, &p1 = vertices[result[t * 3 + 1]].Position,
+                        &p2 = vertices[result[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area == 0.0f)
+            continue;
+        normal /= area;
+        for (int k = 0; k < 3; k++)
+            quadrics[result[t * 3 + k]].addPlane(normal, -glm::dot(normal, p0), area);
+    }
+
+    struct Collapse {
+        unsigned int from, to;
+        float cost;
+    };
+    vector<Collapse> collapses;
+    vector<unsigned int> remap(vertexCount);
+    vector<bool> touched(vertexCount);
+    float maxCost = maxError * maxError, resultError = 0.0f;
+
+    // collapses don't see each other's effect within a pass, so every vertex takes part in at most one per pass
+    while (result.size() > targetIndexCount)
+    {
+        collapses.clear();
+        for (size_t t = 0; t < result.size() / 3; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+                Quadric q = quadrics[a];
+                q.add(quadrics[b]);
+                // both directions, the cheaper one wins once sorted
+                if (!locked[a])
+                    collapses.push_back({a, b, q.error(vertices[b].Position)});
+                if (!locked[b])
+                    collapses.push_back({b, a, q.error(vertices[a].Position)});
+            }
+        }
+        sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        iota(remap.begin(), remap.end(), 0u);
+        fill(touched.begin(), touched.end(), false);
+        // every collapse removes about two triangles, stop a pass once it would overshoot the target
+        size_t removable = (result.size() - targetIndexCount) / 3, removed = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (removed >= removable || collapse.cost > maxCost)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject collapses that flip a triangle around the moving vertex
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            bool flips = false;
+            unsigned int shared = 0;
+            for (unsigned int i = adjacencyOffset[collapse.from]; i < adjacencyOffset[collapse.from + 1] && !flips; i++)
+            {
+                const unsigned int *triangle = &result[adjacency[i] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    shared++;
+                    continue;
+                }
+                glm::vec3 p[3], moved[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[triangle[k]].Position;
+                    moved[k] = triangle[k] == collapse.from ? target : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]), after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            // the whole neighbourhood of the moved vertex changes, keep it out of this pass
+            for (unsigned int i = adjacencyOffset[collapse.from]; i < adjacencyOffset[collapse.from + 1]; i++)
+                for (int k = 0; k < 3; k++)
+                    touched[result[adjacency[i] * 3 + k]] = true;
+            resultError = max(resultError, collapse.cost);
+            removed += shared;
+        }
+        if (removed == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < result.size() / 3; t++)
+        {
+            unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+        buildAdjacency();
+    }
+    return sqrt(resultError);
+}
+
+// builds up to MESH_LOD_LEVELS simplified index buffers for a mesh, each from the previous level.
+// errors are stored relative to the radius of the mesh's bounding sphere, so they can be scaled by its size on screen.
+void generateMeshLods(MeshData &mesh)
+{
+    mesh.lods.clear();
+    if (mesh.indices.size() / 3 < MESH_LOD_MIN_TRIANGLES)
+        return;
+    float radius = mesh.bounds.radius;
+    if (radius <= 0.0f)
+        return;
+
+    mesh.lods.reserve(MESH_LOD_LEVELS); // previous points into it
+    const vector<unsigned int> *previous = &mesh.indices;
+    for (int level = 1; level <= MESH_LOD_LEVELS; level++)
+    {
+        MeshLod lod;
+        size_t target = previous->size() / 6 * 3;
+        float error = simplifyMesh(mesh.vertices, *previous, target, MESH_LOD_MAX_ERROR * radius, lod.indices);
+        if (lod.indices.empty() || lod.indices.size() > previous->size() * MESH_LOD_MIN_REDUCTION)
+            break;
+        // errors add up over the chain, each level is simplified from the previous one
+        lod.error = (mesh.lods.empty() ? 0.0f : mesh.lods.back().error) + error / radius;
+        optimizeVertexCache(lod.indices, mesh.vertices.size());
+        mesh.lods.push_back(move(lod));
+        previous = &mesh.lods.back().indices;
+    }
+}
+#endif
@@ -0,0 +1,220 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAP_SSE2 1
+#endif
+
+// alpha test threshold of the foliage shader (blending.fs), mip levels keep the coverage they have at this cutoff
+const float ALPHA_TEST_CUTOFF = 0.1f;
+const float MIPMAP_PI = 3.14159265f;
+
+// Each level is filtered from the previous one in linear float RGBA, with a separable Kaiser windowed sinc
+// that has three source texels of support on either side. Color is converted from sRGB first (gammaCorrect)
+// and weighted by alpha, so transparent texels don't bleed their color into the visible ones.
+struct MipFilter {
+    bool gammaCorrect = false;
+    bool premultiplyAlpha = false;
+    float alphaCutoff = 0.0f;   // > 0 rescales the alpha of every level to keep level 0's alpha test coverage
+
+    static const int TAPS = 6;
+    float weights[TAPS];
+
+    MipFilter()
+    {
+        // taps sit at +-0.25, +-0.75 and +-1.25 destination texels from the center
+        const float radius = 1.5f, beta = 4.0f;
+        float sum = 0.0f;
+        for (int t = 0; t < TAPS; t++)
+        {
+            float x = (t - 2.5f) * 0.5f;
+            float sinc = sin(MIPMAP_PI * x) / (MIPMAP_PI * x);
+            float window = besselI0(beta * sqrt(1.0f - (x / radius) * (x / radius))) / besselI0(beta);
+            weights[t] = sinc * window;
+            sum += weights[t];
+        }
+        for (int t = 0; t < TAPS; t++)
+            weights[t] /= sum;
+    }
+
+    static float besselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 16; k++)
+        {
+            term *= (x / (2.0f * k)) * (x / (2.0f * k));
+            sum += term;
+        }
+        return sum;
+    }
+};
+
+float srgbToLinear(unsigned char value)
+{
+    static const vector<float> table = [] {
+        vector<float> values(256);
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            values[i] = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return values;
+    }();
+    return table[value];
+}
+
+unsigned char linearToSrgb(float value)
+{
+    static const int STEPS = 4096;
+    static const vector<unsigned char> table = [] {
+        vector<unsigned char> values(STEPS + 1);
+        for (int i = 0; i <= STEPS; i++)
+        {
+            float c = (float)i / STEPS;
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * pow(c, 1.0f / 2.4f) - 0.055f;
+            values[i] = (unsigned char)(c * 255.0f + 0.5f);
+        }
+        return values;
+    }();
+    value = min(max(value, 0.0f), 1.0f);
+    return table[(int)(value * STEPS + 0.5f)];
+}
+
+// downsamples one line of float4 texels by two. strides are in floats, so the same code filters rows and columns.
+// addressing wraps, like the GL_REPEAT textures the chains are built for.
+void downsampleLine(const MipFilter &filter, const float *source, size_t sourceStride, int sourceCount,
+                    float *destination, size_t destinationStride, int destinationCount)
+{
+    for (int i = 0; i < destinationCount; i++)
+    {
+        int first = i * 2 - 2;
+#ifdef MIPMAP_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (int t = 0; t < MipFilter::TAPS; t++)
+        {
+            int j = ((first + t) % sourceCount + sourceCount) % sourceCount;
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + j * sourceStride), _mm_set1_ps(filter.weights[t])));
+        }
+        _mm_storeu_ps(destination + i * destinationStride, sum);
+#else
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (int t = 0; t < MipFilter::TAPS; t++)
+        {
+            int j = ((first + t) % sourceCount + sourceCount) % sourceCount;
+            for (int c = 0; c < 4; c++)
+                sum[c] += source[j * sourceStride + c] * filter.weights[t];
+        }
+        memcpy(destination + i * destinationStride, sum, sizeof(sum));
+#endif
+    }
+}
+
+// halves a float4 level, a side that is already 1 texel is copied instead of filtered
+void downsampleLevel(const MipFilter &filter, const vector<float> &source, int width, int height, vector<float> &destination)
+{
+    int outWidth = max(1, width / 2), outHeight = max(1, height / 2);
+    vector<float> rows((size_t)outWidth * height * 4);
+    for (int y = 0; y < height; y++)
+    {
+        if (width > 1)
+            downsampleLine(filter, &source[(size_t)y * width * 4], 4, width, &rows[(size_t)y * outWidth * 4], 4, outWidth);
+        else
+            memcpy(&rows[(size_t)y * 4], &source[(size_t)y * 4], 4 * sizeof(float));
+    }
+    if (height == 1)
+    {
+        destination.swap(rows);
+        return;
+    }
+    destination.resize((size_t)outWidth * outHeight * 4);
+    for (int x = 0; x < outWidth; x++)
+        downsampleLine(filter, &rows[(size_t)x * 4], (size_t)outWidth * 4, height, &destination[(size_t)x * 4], (size_t)outWidth * 4, outHeight);
+}
+
+// fraction of texels that pass the alpha test when their alpha is multiplied by scale
+float alphaCoverage(const vector<unsigned char> &rgba, float cutoff, float scale)
+{
+    size_t texels = rgba.size() / 4, covered = 0;
+    for (size_t i = 0; i < texels; i++)
+        if (rgba[i * 4 + 3] / 255.0f * scale > cutoff)
+            covered++;
+    return texels ? (float)covered / texels : 0.0f;
+}
+
+// rescales the alpha of a level so as many texels pass the alpha test as in level 0,
+// otherwise alpha tested foliage thins out and disappears in the distance
+void preserveAlphaCoverage(vector<unsigned char> &rgba, float cutoff, float coverage)
+{
+    float low = 0.0f, high = 4.0f, scale = 1.0f;
+    for (int step = 0; step < 10; step++)
+    {
+        scale = (low + high) * 0.5f;
+        if (alphaCoverage(rgba, cutoff, scale) < coverage)
+            low = scale;
+        else
+            high = scale;
+    }
+    for (size_t i = 0; i < rgba.size() / 4; i++)
+        rgba[i * 4 + 3] = (unsigned char)min(rgba[i * 4 + 3] * scale + 0.5f, 255.0f);
+}
+
+void storeLevel(const MipFilter &filter, const vector<float> &level, vector<unsigned char> &rgba)
+{
+    size_t texels = level.size() / 4;
+    rgba.resize(texels * 4);
+    for (size_t i = 0; i < texels; i++)
+    {
+        const float *texel = &level[i * 4];
+        float alpha = min(max(texel[3], 0.0f), 1.0f);
+        float unpremultiply = filter.premultiplyAlpha ? (alpha > 0.0f ? 1.0f / alpha : 0.0f) : 1.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            float value = texel[c] * unpremultiply;
+            rgba[i * 4 + c] = filter.gammaCorrect ? linearToSrgb(value)
+                                                  : (unsigned char)(min(max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        rgba[i * 4 + 3] = (unsigned char)(alpha * 255.0f + 0.5f);
+    }
+}
+
+// builds the full mip chain of an RGBA8 image, levels[0] is the image itself and
+// level i is max(1, width >> i) x max(1, height >> i), down to 1x1.
+void buildMipChain(const MipFilter &filter, vector<unsigned char> image, int width, int height, vector<vector<unsigned char>> &levels)
+{
+    size_t texels = (size_t)width * height;
+    vector<float> level(texels * 4), next;
+    for (size_t i = 0; i < texels; i++)
+    {
+        float alpha = image[i * 4 + 3] / 255.0f;
+        for (int c = 0; c < 3; c++)
+        {
+            float value = filter.gammaCorrect ? srgbToLinear(image[i * 4 + c]) : image[i * 4 + c] / 255.0f;
+            level[i * 4 + c] = filter.premultiplyAlpha ? value * alpha : value;
+        }
+        level[i * 4 + 3] = alpha;
+    }
+
+    float coverage = filter.alphaCutoff > 0.0f ? alphaCoverage(image, filter.alphaCutoff, 1.0f) : 0.0f;
+    levels.clear();
+    levels.push_back(move(image));
+    while (width > 1 || height > 1)
+    {
+        downsampleLevel(filter, level, width, height, next);
+        level.swap(next);
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+
+        levels.emplace_back();
+        storeLevel(filter, level, levels.back());
+        if (filter.alphaCutoff > 0.0f)
+            preserveAlphaCoverage(levels.back(), filter.alphaCutoff, coverage);
+    }
+}
+#endif
@@ -10,20 +10,43 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/scene_graph.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_array.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/vfs_assimp.h>
 
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
-
+// everything a model load produces before OpenGL is involved. Filled by Model::importModel, which can run on a worker thread,
+// and consumed by Model::uploadModel on the GL thread. Textures are decoded and uploaded separately by the TextureStreamer.
+struct ModelPayload {
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    map<string, TextureSource> textures; // keyed by the texture path relative to directory
+    vector<TextureArrayData> textureArrays;  // textures packed into arrays, see Model::SetTextureArrays
+    bool failed = false;
+    bool cacheHit = false;
+    double milliseconds = 0.0;
+};
 
 class Model
 {
@@ -33,6 +56,16 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    std::string glslIdentifierPrefix;
+    MeshOptions meshOptions;  // applied to the meshes uploaded from now on
+    bool textureArrays = false;  // applied to the models imported from now on
+    CullingBounds cullingBounds;  // bounds of the meshes, in mesh order
+    vector<unsigned char> meshVisibility;
+
+    // constructs an empty model, to be filled later by a ModelLoader.
+    Model(bool gamma = false) : gammaCorrection(gamma)
+    {
+    }
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -40,68 +73,365 @@ public:
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // textures are shared through the TextureRegistry, each model holds one reference per texture it uses.
+    // the meshes' geometry (and their LODs) goes back to the GeometryPool.
+    ~Model()
+    {
+        for (const Texture &texture : textures_loaded)
+            TextureRegistry::shared().release(texture.id);
+        for (const Mesh &mesh : meshes)
+        {
+            GeometryPool::shared().release(mesh.geometry);
+            for (const MeshLodLevel &level : mesh.lods)
+                GeometryPool::shared().release(level.geometry);
+        }
+    }
+
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    // false while the model is still being loaded asynchronously (or if loading failed)
+    bool isLoaded() const
+    {
+        return !meshes.empty();
+    }
+
+    // draws the model, and thus all its meshes. Meshes of a model usually share one vertex layout and often a material,
+    // so the vertex array and the textures are only bound when they change. the shader's samplers must already point
+    // at the material units (see setMaterialSamplers)
     void Draw(Shader &shader)
     {
+        MeshUniforms uniforms(shader);
+        unsigned int boundVAO = 0;
+        const Material *boundMaterial = nullptr;
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            if (!meshes[i].visible)
+                continue;
+            if (meshes[i].VAO != boundVAO)
+            {
+                boundVAO = meshes[i].VAO;
+                glBindVertexArray(boundVAO);
+            }
+            if (meshes[i].material != boundMaterial)
+            {
+                boundMaterial = meshes[i].material;
+                meshes[i].BindTextures();
+            }
+            meshes[i].DrawGeometry(uniforms);
+        }
+        glBindVertexArray(0);
+    }
+
+    // marks the meshes outside the view frustum as invisible for this frame, model is the model matrix it's drawn with.
+    // the frustum is moved into model space, so the bounds are tested as they are
+    void Cull(const glm::mat4 &projectionView, const glm::mat4 &model, CullingStats &stats)
+    {
+        Frustum frustum = Frustum::fromMatrix(projectionView * model);
+        meshVisibility.resize(meshes.size());
+        size_t visible = cullBounds(frustum, cullingBounds, meshVisibility.data());
+        for (size_t i = 0; i < meshes.size(); i++)
+            meshes[i].visible = meshVisibility[i] != 0;
+        stats.submitted += visible;
+        stats.culled += meshes.size() - visible;
+    }
+
+    // picks the level of detail of every mesh for this frame from its projected size, model is the model matrix it's drawn with.
+    // returns the number of triangles that will be drawn, meshes culled by Cull don't count
+    size_t SelectLod(const glm::mat4 &model, const LodContext &context)
+    {
+        float scale = maxAxisScale(model);
+        size_t triangles = 0;
+        for (Mesh &mesh : meshes)
+        {
+            if (!mesh.visible)
+                continue;
+            glm::vec3 center = glm::vec3(model * glm::vec4(mesh.bounds.center, 1.0f));
+            mesh.selectLod(context.radiusPixels(center, mesh.bounds.radius * scale), context.bias);
+            triangles += mesh.lodTriangleCount();
+        }
+        return triangles;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // vertex format of the meshes uploaded from now on, VERTEX_FORMAT_PACKED needs a shader that decodes it
+    // (see 2.model_lighting.vs)
+    void SetVertexFormat(VertexFormat format) {
+        meshOptions.format = format;
+    }
+
+    // only uploads the vertex attributes the shader reads, meshes drawn with another shader may miss attributes it needs
+    void SetShaderAttributes(const Shader &shader) {
+        meshOptions.attributeMask = shader.attributeMask;
+    }
+
+    // keeps the vertices and indices of the meshes uploaded from now on in RAM, for collision or picking.
+    // by default only their bounds and counts remain once the GPU has a copy
+    void SetKeepCpuData(bool keep) {
+        meshOptions.keepCpuData = keep;
+    }
+
+    // lets meshes use triangle strips with primitive restart where that takes fewer indices than a triangle list
+    void SetIndexStrips(bool strips) {
+        meshOptions.indexStrips = strips;
+    }
+
+    // packs the material textures of the models imported from now on into texture arrays (see texture_array.h),
+    // so meshes that only differ in their textures draw with the same material. needs a shader that reads textureLayers
+    void SetTextureArrays(bool enabled) {
+        textureArrays = enabled;
+    }
+
+    // what importModel needs to build the texture arrays, must be called on the GL thread
+    TextureArrayOptions textureArrayOptions() const
+    {
+        TextureArrayOptions options;
+        options.enabled = textureArrays;
+        options.compress = TextureStreamer::shared().compressionEnabled();
+        options.allowS3TC = textureArrays && options.compress && hasS3TCSupport();
+        return options;
+    }
+
+    // imports a model without touching OpenGL, so it's safe to call from worker threads.
+    // processed meshes are kept in the mesh cache, so assimp only runs the first time a model (or its import flags) changes.
+    static void importModel(string const &path, ModelPayload &payload, const TextureArrayOptions &arrays = TextureArrayOptions())
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        auto start = chrono::steady_clock::now();
+        payload.path = path;
+        // retrieve the directory path of the filepath
+        payload.directory = path.substr(0, path.find_last_of('/'));
+
+        payload.cacheHit = MeshCache::load(path, importFlags, payload.meshes);
+        if (!payload.cacheHit)
+        {
+            // read file via ASSIMP, the model and the files it references come out of the VirtualFileSystem
+            Assimp::Importer importer;
+            importer.SetIOHandler(new VfsIOSystem());
+            const aiScene* scene = importer.ReadFile(path, importFlags);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                payload.failed = true;
+                return;
+            }
+            // process ASSIMP's root node recursively, then move the meshes to where their nodes put them
+            payload.meshes.reserve(scene->mNumMeshes);
+            SceneGraph nodes;
+            vector<int> meshNodes;
+            processNode(scene->mRootNode, scene, SCENE_NO_PARENT, nodes, payload.meshes, meshNodes);
+            nodes.update();
+            bakeNodeTransforms(nodes, meshNodes, payload.meshes);
+            // assimp's output is unwelded and in arbitrary order, optimize it once here so the cache holds the result,
+            // together with the simplified levels of detail
+            MeshOptimizationStats optimization;
+            size_t lodCount = 0;
+            for (MeshData &data : payload.meshes)
+            {
+                optimizeMesh(data, optimization);
+                generateMeshLods(data);
+                lodCount += data.lods.size();
+            }
+            cout << "MODEL::OPTIMIZE:: " << path << ": " << optimization.verticesBefore << " -> " << optimization.verticesAfter
+                 << " vertices, ACMR " << optimization.acmrBefore() << " -> " << optimization.acmrAfter()
+                 << ", " << lodCount << " LODs" << endl;
+            MeshCache::store(path, importFlags, payload.meshes);
+        }
+
+        // read and hash every texture once, even if several meshes use it, so the registry can tell duplicates apart
+        for (const MeshData &data : payload.meshes)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            for (const Texture &texture : data.textures)
+            {
+                if (payload.textures.count(texture.path))
+                    continue;
+                describeTextureFile(payload.directory + '/' + texture.path, true, TEXTURE_KIND_2D, payload.textures[texture.path],
+                                    textureUsageFromType(texture.type));
+            }
+        }
+        if (arrays.enabled)
+            buildTextureArrays(payload.meshes, payload.textures, arrays, payload.textureArrays);
+        payload.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // creates the meshes and textures of an imported model, must be called on the thread that owns the GL context.
+    void uploadModel(ModelPayload &payload)
+    {
+        if (payload.failed)
             return;
+        auto start = chrono::steady_clock::now();
+        directory = payload.directory;
+        meshes.reserve(meshes.size() + payload.meshes.size());
+        // the array texture and layer of every (type, path) that was packed
+        map<pair<string, string>, pair<unsigned int, unsigned int>> packed;
+        for (const TextureArrayData &array : payload.textureArrays)
+        {
+            TextureSource source;
+            source.key = array.key;
+            source.bytes = textureArrayBytes(array);
+            source.valid = true;
+            Texture texture;
+            texture.id = TextureRegistry::shared().acquire(source, [&] { return uploadTextureArray(array); });
+            texture.type = array.type + "_array";
+            textures_loaded.push_back(texture);
+            for (unsigned int layer = 0; layer < array.paths.size(); layer++)
+                packed[make_pair(array.type, array.paths[layer])] = make_pair(texture.id, layer);
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+        vector<TextureArrayData>().swap(payload.textureArrays);
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        for (MeshData &data : payload.meshes)
+        {
+            glm::vec4 textureLayers(-1.0f);
+            for (Texture &texture : data.textures)
+            {
+                auto inArray = packed.find(make_pair(texture.type, texture.path));
+                int type = materialTextureType(texture.type);
+                if (inArray != packed.end() && textureLayers[type] < 0.0f)
+                {
+                    textureLayers[type] = (float)inArray->second.second;
+                    texture.id = inArray->second.first;
+                    texture.type += "_array";
+                }
+                else
+                    texture = loadMaterialTexture(texture.path, texture.type, payload.textures[texture.path]);
+            }
+            meshes.emplace_back(move(data), meshOptions);
+            meshes.back().glslIdentifierPrefix = glslIdentifierPrefix;
+            meshes.back().textureLayers = textureLayers;
+            const Bounds &bounds = meshes.back().bounds;
+            cullingBounds.add(bounds.center, bounds.radius, bounds.min, bounds.max);
+        }
+        // the meshes took the data over, drop the emptied shells too
+        vector<MeshData>().swap(payload.meshes);
+
+        double milliseconds = payload.milliseconds + chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        ModelLoadStats &stats = modelLoadStats();
+        if (payload.cacheHit)
+        {
+            stats.cacheHits++;
+            stats.cacheMilliseconds += milliseconds;
+        }
+        else
+        {
+            stats.cacheMisses++;
+            stats.importMilliseconds += milliseconds;
+        }
+        cout << "MODEL::LOAD:: " << payload.path << (payload.cacheHit ? " (cache hit, " : " (imported, ") << milliseconds << " ms)" << endl;
+    }
+
+private:
+    // assimp post processing applied to every model, part of the mesh cache key
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    void loadModel(string const &path)
+    {
+        ModelPayload payload;
+        importModel(path, payload, textureArrayOptions());
+        uploadModel(payload);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // the nodes go into a scene graph with their transforms, meshNodes[i] is the node meshData[i] hangs from.
+    // a mesh referenced by several nodes is processed once per node
+    static void processNode(aiNode *node, const aiScene *scene, int parent, SceneGraph &nodes, vector<MeshData> &meshData,
+                            vector<int> &meshNodes)
     {
+        int index = nodes.add(toMat4(node->mTransformation), parent, node->mName.C_Str());
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.push_back(processMesh(mesh, scene));
+            meshNodes.push_back(index);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, index, nodes, meshData, meshNodes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // assimp matrices are row major
+    static glm::mat4 toMat4(const aiMatrix4x4 &m)
+    {
+        glm::mat4 matrix;
+        matrix[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+        matrix[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+        matrix[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+        matrix[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+        return matrix;
+    }
+
+    // Moves every mesh by the world transform of its node, so the model is drawn as a single object. transforms are
+    // taken relative to the node of the first mesh: a model whose meshes all hang from one node keeps the space it
+    // had when the nodes were ignored, which is the one the placements of the scene are made for. animations aren't
+    // played, so meshes under an animated node are baked at the node's rest transform too, which is where they are drawn
+    static void bakeNodeTransforms(const SceneGraph &nodes, const vector<int> &meshNodes, vector<MeshData> &meshes)
+    {
+        if (meshes.empty())
+            return;
+        glm::mat4 reference = glm::inverse(nodes.world(meshNodes[0]));
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            glm::mat4 transform = reference * nodes.world(meshNodes[i]);
+            bool identity = true;
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    identity = identity && fabs(transform[column][row] - (column == row ? 1.0f : 0.0f)) < 1e-5f;
+            if (!identity)
+                transformMeshData(meshes[i], transform);
+        }
+    }
+
+    // positions by the transform, normals by its inverse transpose. a mirroring transform flips the triangles' winding,
+    // so their order is swapped back
+    static void transformMeshData(MeshData &data, const glm::mat4 &transform)
+    {
+        glm::mat3 linear(transform);
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+        auto direction = [](const glm::mat3 &matrix, const glm::vec3 &vector) {
+            glm::vec3 moved = matrix * vector;
+            float length = glm::length(moved);
+            // attributes the mesh doesn't have are zero and stay that way
+            return length > 0.0f ? moved / length : moved;
+        };
+        for (Vertex &vertex : data.vertices)
+        {
+            vertex.Position = glm::vec3(transform * glm::vec4(vertex.Position, 1.0f));
+            vertex.Normal = direction(normalMatrix, vertex.Normal);
+            vertex.Tangent = direction(linear, vertex.Tangent);
+            vertex.Bitangent = direction(linear, vertex.Bitangent);
+        }
+        if (glm::determinant(linear) < 0.0f)
+            for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+                swap(data.indices[i + 1], data.indices[i + 2]);
+        data.bounds = computeBounds(data.vertices);
+    }
+
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex = {}; // zero initialized, so attributes the mesh doesn't have are cached deterministically
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -140,9 +470,8 @@ private:
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
-
-
         }
+        data.bounds = computeBounds(vertices);
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
@@ -178,82 +507,63 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, textures are resolved to ids once the mesh is created
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects the paths of all material textures of a given type, the textures themselves are loaded later by loadMaterialTexture.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // loads a texture if it's not loaded yet, the required info is returned as a Texture struct.
+    // textures with the same contents as one loaded by any model are shared through the TextureRegistry.
+    Texture loadMaterialTexture(const string &path, const string &typeName, const TextureSource &source)
+    {
+        // check if texture was loaded before and if so, reuse it: skip loading a new texture
+        auto loaded = texturesByPath.find(path);
+        if (loaded != texturesByPath.end())
+        {
+            Texture texture = textures_loaded[loaded->second]; // a texture with the same filepath has already been loaded (optimization)
+            texture.type = typeName;
+            return texture;
+        }
+        // if texture hasn't been loaded already, load it
+        Texture texture;
+        texture.id = TextureRegistry::shared().acquire(source, [&] {
+            return TextureStreamer::shared().load(this->directory + '/' + path, true, source.valid ? source.contents[0] : FileView(),
+                                                  textureUsageFromType(typeName));
+        });
+        texture.type = typeName;
+        texture.path = path;
+        texturesByPath[path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
+
+    unordered_map<string, size_t> texturesByPath; // index into textures_loaded
 };
 
 
+// starts streaming a texture in, the returned id can be used right away (see TextureStreamer).
+// the texture is shared through the TextureRegistry, release it there when it's no longer needed.
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::shared().load(filename, true);
 }
 #endif
@@ -0,0 +1,97 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+using namespace std;
+
+// Loads models in the background: assimp import, mesh processing and texture decoding run on worker threads,
+// the finished payloads are queued and uploaded on the GL thread by processUploads, which the render loop calls every frame.
+// a model stays empty (and draws nothing) until its upload has run.
+class ModelLoader
+{
+public:
+    explicit ModelLoader(ThreadPool &pool = ThreadPool::shared()) : pool(pool)
+    {
+    }
+
+    // waits for imports that are still running, they hold a pointer to this loader
+    ~ModelLoader()
+    {
+        unique_lock<mutex> lock(queueMutex);
+        importFinished.wait(lock, [this] { return importing == 0; });
+    }
+
+    ModelLoader(const ModelLoader &) = delete;
+    ModelLoader &operator=(const ModelLoader &) = delete;
+
+    // starts loading a model into the given (empty) Model, which must outlive the loader's processUploads calls.
+    void load(Model &model, const string &path)
+    {
+        if (requested++ == 0)
+            startTime = chrono::steady_clock::now();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            importing++;
+        }
+        Model *target = &model;
+        TextureArrayOptions arrays = model.textureArrayOptions();
+        pool.enqueue([this, target, path, arrays] {
+            shared_ptr<ModelPayload> payload = make_shared<ModelPayload>();
+            Model::importModel(path, *payload, arrays);
+
+            lock_guard<mutex> lock(queueMutex);
+            uploads.push_back([target, payload] { target->uploadModel(*payload); });
+            importing--;
+            importFinished.notify_all();
+        });
+    }
+
+    // uploads every model whose import has finished since the last call, must be called on the GL thread
+    void processUploads()
+    {
+        deque<function<void()>> ready;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            ready.swap(uploads);
+        }
+        for (function<void()> &upload : ready)
+        {
+            upload();
+            if (++uploaded == requested)
+                loadMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+        }
+    }
+
+    unsigned int pending() const
+    {
+        return requested - uploaded;
+    }
+
+    // wall clock time from the first load request until the last model was uploaded, 0 while models are still loading
+    double totalMilliseconds() const
+    {
+        return pending() == 0 ? loadMilliseconds : 0.0;
+    }
+
+private:
+    ThreadPool &pool;
+    mutex queueMutex;
+    condition_variable importFinished;
+    deque<function<void()>> uploads;
+    unsigned int importing = 0;
+
+    // only touched on the GL thread
+    unsigned int requested = 0;
+    unsigned int uploaded = 0;
+    chrono::steady_clock::time_point startTime;
+    double loadMilliseconds = 0.0;
+};
+#endif
@@ -0,0 +1,358 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/thread_pool.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#endif
+
+// resolution of the software depth buffer, a multiple of the tile size
+const int OCCLUSION_WIDTH = 320;
+const int OCCLUSION_HEIGHT = 192;
+// tiles are rasterized independently, one thread each. widths are a multiple of 4 for the SIMD rows
+const int OCCLUSION_TILE_WIDTH = 64;
+const int OCCLUSION_TILE_HEIGHT = 32;
+// occluders are clipped to this many times the screen, so far off vertices don't ruin the edge function precision
+const float OCCLUSION_GUARD_BAND = 4.0f;
+
+// what the last frame did, for the stats window
+struct OcclusionStats {
+    size_t occluderTriangles = 0;  // after clipping
+    size_t tested = 0;
+    size_t occluded = 0;
+    float milliseconds = 0.0f;
+};
+
+// Low resolution depth buffer rasterized on the CPU from a few large occluders, and a max depth pyramid over it
+// to test bounding boxes against. Per frame: begin, addOccluder for every occluder, rasterize, then isVisible.
+// Depth is window depth in [0, 1] like the GL default depth range, nearer is smaller. Tiles don't share pixels, so
+// the result doesn't depend on how they are spread over the threads.
+class OcclusionBuffer
+{
+public:
+    explicit OcclusionBuffer(ThreadPool &pool = ThreadPool::shared()) : pool(pool)
+    {
+        int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+        while (true)
+        {
+            levels.push_back(Level{width, height, vector<float>((size_t)width * height, 1.0f)});
+            if (width == 1 && height == 1)
+                break;
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+        }
+        bins.resize(tileCount());
+    }
+
+    void begin(const glm::mat4 &projectionView)
+    {
+        start = chrono::steady_clock::now();
+        this->projectionView = projectionView;
+        triangles.clear();
+        for (vector<unsigned int> &bin : bins)
+            bin.clear();
+        stats = OcclusionStats();
+    }
+
+    // world space triangles, three corners each
+    void addOccluder(const vector<glm::vec3> &corners)
+    {
+        for (size_t i = 0; i + 2 < corners.size(); i += 3)
+        {
+            glm::vec4 polygon[9], clipped[9];
+            for (int k = 0; k < 3; k++)
+                polygon[k] = projectionView * glm::vec4(corners[i + k], 1.0f);
+            // near plane (z >= -w) first, which leaves w positive for the divide, then the guard band
+            int count = 3;
+            count = clip(polygon, count, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), clipped);
+            count = clip(clipped, count, glm::vec4(1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND), polygon);
+            count = clip(polygon, count, glm::vec4(-1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND), clipped);
+            count = clip(clipped, count, glm::vec4(0.0f, 1.0f, 0.0f, OCCLUSION_GUARD_BAND), polygon);
+            count = clip(polygon, count, glm::vec4(0.0f, -1.0f, 0.0f, OCCLUSION_GUARD_BAND), clipped);
+            for (int k = 1; k + 1 < count; k++)
+                setupTriangle(clipped[0], clipped[k], clipped[k + 1]);
+        }
+    }
+
+    // rasterizes the occluders over the pool and builds the pyramid
+    void rasterize()
+    {
+        stats.occluderTriangles = triangles.size();
+        for (Level &level : levels)
+            fill(level.depth.begin(), level.depth.end(), 1.0f);
+
+        // the calling thread works on tiles too. helpers that only start after every tile was taken leave without
+        // touching the buffer, so a busy pool never holds up the frame
+        shared_ptr<TileWork> work = make_shared<TileWork>();
+        work->count = tileCount();
+        auto rasterizeTiles = [this, work]() {
+            for (unsigned int tile; (tile = work->next++) < work->count;)
+            {
+                rasterizeTile(tile);
+                lock_guard<mutex> lock(work->doneMutex);
+                if (++work->done == work->count)
+                    work->allDone.notify_all();
+            }
+        };
+        unsigned int helpers = min(pool.size(), work->count - 1);
+        for (unsigned int i = 0; i < helpers; i++)
+            pool.enqueue(rasterizeTiles);
+        rasterizeTiles();
+        {
+            unique_lock<mutex> lock(work->doneMutex);
+            work->allDone.wait(lock, [&] { return work->done == work->count; });
+        }
+
+        buildPyramid();
+        stats.milliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // false when the box is certainly behind the occluders, boxes reaching past the near plane are always visible
+    bool isVisible(const Aabb &box)
+    {
+        stats.tested++;
+        glm::vec2 minimum(numeric_limits<float>::max()), maximum(-numeric_limits<float>::max());
+        float nearest = numeric_limits<float>::max();
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 point(corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z);
+            glm::vec4 clip = projectionView * glm::vec4(point, 1.0f);
+            if (clip.z < -clip.w)
+                return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            minimum = glm::min(minimum, glm::vec2(ndc.x, ndc.y));
+            maximum = glm::max(maximum, glm::vec2(ndc.x, ndc.y));
+            nearest = min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (maximum.x < -1.0f || maximum.y < -1.0f || minimum.x > 1.0f || minimum.y > 1.0f)
+            return true; // off screen, that's for the frustum test to decide
+
+        int x0 = toPixel(minimum.x, OCCLUSION_WIDTH), x1 = toPixel(maximum.x, OCCLUSION_WIDTH);
+        int y0 = toPixel(minimum.y, OCCLUSION_HEIGHT), y1 = toPixel(maximum.y, OCCLUSION_HEIGHT);
+        // the level where the rectangle covers at most 2x2 texels
+        size_t level = 0;
+        while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+            level++;
+        const Level &pyramid = levels[level];
+        float farthest = 0.0f;
+        for (int y = y0 >> level; y <= y1 >> level; y++)
+            for (int x = x0 >> level; x <= x1 >> level; x++)
+                farthest = max(farthest, pyramid.depth[(size_t)y * pyramid.width + x]);
+        if (nearest <= farthest)
+            return true;
+        stats.occluded++;
+        return false;
+    }
+
+    // the full resolution depth, rows from the bottom of the screen up
+    const vector<float> &depth() const
+    {
+        return levels[0].depth;
+    }
+
+    const OcclusionStats &lastStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Level {
+        int width, height;
+        vector<float> depth;
+    };
+
+    // edge functions a * x + b * y + c, positive inside, and depth as a plane over the screen
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    struct TileWork {
+        atomic<unsigned int> next{0};
+        unsigned int count = 0, done = 0;
+        mutex doneMutex;
+        condition_variable allDone;
+    };
+
+    ThreadPool &pool;
+    vector<Level> levels;
+    vector<Triangle> triangles;
+    vector<vector<unsigned int>> bins;  // triangles overlapping each tile
+    glm::mat4 projectionView = glm::mat4(1.0f);
+    OcclusionStats stats;
+    chrono::steady_clock::time_point start;
+
+    static unsigned int tilesX()
+    {
+        return OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+    }
+
+    static unsigned int tileCount()
+    {
+        return tilesX() * (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT);
+    }
+
+    static int toPixel(float ndc, int size)
+    {
+        return min(max((int)floor((ndc * 0.5f + 0.5f) * size), 0), size - 1);
+    }
+
+    // Sutherland-Hodgman against dot(plane, p) >= 0
+    static int clip(const glm::vec4 *input, int count, const glm::vec4 &plane, glm::vec4 *output)
+    {
+        int written = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const glm::vec4 &a = input[i], &b = input[(i + 1) % count];
+            float da = glm::dot(plane, a), db = glm::dot(plane, b);
+            if (da >= 0.0f)
+                output[written++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                output[written++] = a + (b - a) * (da / (da - db));
+        }
+        return written;
+    }
+
+    void setupTriangle(const glm::vec4 &c0, const glm::vec4 &c1, const glm::vec4 &c2)
+    {
+        glm::vec3 v[3];
+        const glm::vec4 *clip[3] = {&c0, &c1, &c2};
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 ndc = glm::vec3(*clip[k]) / clip[k]->w;
+            v[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+        }
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (area == 0.0f || !isfinite(area))
+            return;
+        // occluders are drawn from both sides, wind them all the same way
+        if (area < 0.0f)
+        {
+            swap(v[1], v[2]);
+            area = -area;
+        }
+
+        Triangle triangle;
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec3 &a = v[k], &b = v[(k + 1) % 3];
+            triangle.edgeA[k] = a.y - b.y;
+            triangle.edgeB[k] = b.x - a.x;
+            triangle.edgeC[k] = a.x * b.y - a.y * b.x;
+        }
+        // z at p is the barycentric mix of the corners, the weight of corner k is the edge opposite it over the area
+        triangle.depthA = triangle.depthB = triangle.depthC = 0.0f;
+        for (int k = 0; k < 3; k++)
+        {
+            float z = v[(k + 2) % 3].z / area;
+            triangle.depthA += triangle.edgeA[k] * z;
+            triangle.depthB += triangle.edgeB[k] * z;
+            triangle.depthC += triangle.edgeC[k] * z;
+        }
+        // pixels whose centers can be inside
+        triangle.minX = max((int)floor(min(min(v[0].x, v[1].x), v[2].x) - 0.5f), 0);
+        triangle.maxX = min((int)ceil(max(max(v[0].x, v[1].x), v[2].x) - 0.5f), OCCLUSION_WIDTH - 1);
+        triangle.minY = max((int)floor(min(min(v[0].y, v[1].y), v[2].y) - 0.5f), 0);
+        triangle.maxY = min((int)ceil(max(max(v[0].y, v[1].y), v[2].y) - 0.5f), OCCLUSION_HEIGHT - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        unsigned int index = (unsigned int)triangles.size();
+        triangles.push_back(triangle);
+        for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty++)
+            for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx++)
+                bins[ty * tilesX() + tx].push_back(index);
+    }
+
+    void rasterizeTile(unsigned int tile)
+    {
+        int tileX = (int)(tile % tilesX()) * OCCLUSION_TILE_WIDTH, tileY = (int)(tile / tilesX()) * OCCLUSION_TILE_HEIGHT;
+        vector<float> &depth = levels[0].depth;
+        for (unsigned int index : bins[tile])
+        {
+            const Triangle &triangle = triangles[index];
+            // whole groups of 4 pixels, the tile edges are multiples of 4 so the groups never leave it
+            int x0 = max(triangle.minX, tileX) & ~3, x1 = min(triangle.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+            int y0 = max(triangle.minY, tileY), y1 = min(triangle.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = (float)y + 0.5f;
+                float *row = &depth[(size_t)y * OCCLUSION_WIDTH];
+#ifdef OCCLUSION_SSE2
+                const __m128 zero = _mm_setzero_ps(), lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+                __m128 edge[3], edgeStep[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    edge[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[k]), _mm_add_ps(_mm_set1_ps((float)x0), lanes)),
+                                         _mm_set1_ps(triangle.edgeB[k] * py + triangle.edgeC[k]));
+                    edgeStep[k] = _mm_set1_ps(triangle.edgeA[k] * 4.0f);
+                }
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthA), _mm_add_ps(_mm_set1_ps((float)x0), lanes)),
+                                      _mm_set1_ps(triangle.depthB * py + triangle.depthC));
+                __m128 zStep = _mm_set1_ps(triangle.depthA * 4.0f);
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+                    if (_mm_movemask_ps(inside))
+                    {
+                        __m128 current = _mm_loadu_ps(row + x);
+                        __m128 nearer = _mm_min_ps(current, z);
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                    }
+                    for (int k = 0; k < 3; k++)
+                        edge[k] = _mm_add_ps(edge[k], edgeStep[k]);
+                    z = _mm_add_ps(z, zStep);
+                }
+#else
+                for (int x = x0; x < ((x1 + 4) & ~3); x++)
+                {
+                    float px = (float)x + 0.5f;
+                    bool inside = true;
+                    for (int k = 0; k < 3; k++)
+                        inside &= triangle.edgeA[k] * px + triangle.edgeB[k] * py + triangle.edgeC[k] >= 0.0f;
+                    if (inside)
+                        row[x] = min(row[x], triangle.depthA * px + triangle.depthB * py + triangle.depthC);
+                }
+#endif
+            }
+        }
+    }
+
+    // every texel keeps the farthest depth of the 2x2 texels under it, so texel x of level l covers pixels
+    // x << l to ((x + 1) << l) - 1. the last texel of an odd size only has one texel under it in that direction
+    void buildPyramid()
+    {
+        for (size_t l = 1; l < levels.size(); l++)
+        {
+            const Level &source = levels[l - 1];
+            Level &target = levels[l];
+            for (int y = 0; y < target.height; y++)
+            {
+                int sy0 = min(y * 2, source.height - 1), sy1 = min(y * 2 + 1, source.height - 1);
+                for (int x = 0; x < target.width; x++)
+                {
+                    int sx0 = min(x * 2, source.width - 1), sx1 = min(x * 2 + 1, source.width - 1);
+                    const float *row0 = &source.depth[(size_t)sy0 * source.width], *row1 = &source.depth[(size_t)sy1 * source.width];
+                    target.depth[(size_t)y * target.width + x] = max(max(row0[sx0], row0[sx1]), max(row1[sx0], row1[sx1]));
+                }
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,573 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/geometry_pool.h>
+#include <learnopengl/gl_features.h>
+#include <learnopengl/instancing.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+using namespace std;
+
+// passes run in this order: opaque front to back, the sky behind them, then the blended geometry back to front
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_SKY = 1,
+    RENDER_PASS_TRANSPARENT = 2
+};
+
+// fixed function state a draw needs, everything else is left as the frame set it up
+enum RenderStateFlags {
+    RENDER_CULL_FACE = 1
+};
+
+// draws that don't set a model matrix
+const unsigned int RENDER_NO_OBJECT = 0xFFFFFFFF;
+
+// One draw: an item is what gets sorted, the command it points to holds what's needed to issue it.
+// key layout, most significant first:
+//   opaque and sky: pass 2 | shader 8 | material 16 | VAO 14 | depth 24, state changes first, then front to back
+//   transparent:    pass 2 | far to near depth 24 | shader 8 | material 16 | VAO 14
+// the GL names are truncated to their fields, two names sharing a field only cost a state change, never a wrong draw
+struct RenderItem {
+    uint64_t key;
+    unsigned int command;
+};
+
+struct RenderCommand {
+    Shader *shader = nullptr;
+    unsigned int object = RENDER_NO_OBJECT;
+    Mesh *mesh = nullptr;  // a mesh of a model, or null for the array draw below
+    unsigned int VAO = 0;
+    unsigned int material = 0;  // Material::id of the mesh, or the texture of an array draw, only used for the key
+    GLenum textureTarget = GL_TEXTURE_2D;
+    unsigned int texture = 0;  // bound to unit 0 for array draws
+    GLenum mode = GL_TRIANGLES;
+    int first = 0, count = 0;
+    unsigned int lod = 0;      // level of detail of the mesh
+    unsigned int state = 0;    // RenderStateFlags
+    // instanced draws read their transforms from firstInstance on, on top of the object's model matrix
+    const InstanceBuffer *instances = nullptr;
+    size_t firstInstance = 0;
+    GLsizei instanceCount = 1;
+};
+
+// what a frame's execute did, the changes are the GL calls the sorting couldn't avoid
+struct RenderQueueStats {
+    size_t draws = 0;
+    size_t instances = 0;  // drawn by the draws, more than draws when some are instanced
+    size_t drawCalls = 0;  // GL draw calls issued for them, fewer than draws when multi draw indirect batches them
+    size_t programChanges = 0;
+    size_t vertexArrayChanges = 0;
+    size_t materialChanges = 0;
+    size_t objectChanges = 0;
+};
+
+// binding point of the draw data buffer of the indirect path
+const GLuint INDIRECT_DRAW_DATA_BINDING = 1;
+
+// what glMultiDrawElementsIndirect reads per draw
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;  // the index of the draw's IndirectDrawData
+};
+
+// the per draw uniforms of the mesh shaders, one std430 record per indirect draw.
+// keep in sync with the DrawData buffer of 2.model_lighting_indirect.vs
+struct IndirectDrawData {
+    glm::mat4 model;
+    glm::vec4 textureLayers;
+    glm::vec4 positionScale;   // w is 1 for packed vertices
+    glm::vec4 positionOffset;
+    glm::vec4 parameters;      // of the object, see RenderQueue::addObject
+};
+
+static_assert(sizeof(IndirectDrawData) == 128, "std430 size of DrawData");
+
+// LSD radix sort on the keys, a byte per pass. passes where every key has the same byte are skipped,
+// which with the layout above is most of them. stable, so equal keys keep their submission order
+void radixSortRenderItems(vector<RenderItem> &items, vector<RenderItem> &scratch)
+{
+    scratch.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t offsets[256] = {};
+        for (const RenderItem &item : items)
+            offsets[(item.key >> shift) & 0xFF]++;
+        if (offsets[(items.empty() ? 0 : items[0].key >> shift) & 0xFF] == items.size())
+            continue;
+        size_t sum = 0;
+        for (size_t &offset : offsets)
+        {
+            size_t count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for (const RenderItem &item : items)
+            scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+        items.swap(scratch);
+    }
+}
+
+// Collects the draws of a frame, sorts them by their keys and issues them skipping the program, VAO, texture and
+// model matrix changes that match what's already bound. uniforms that are the same for the whole frame (view,
+// projection, lights) are set on the shaders before execute, per object ones go through addObject.
+// programs that draw meshes need their samplers pointed at the material units once (see setMaterialSamplers).
+// repeated objects are drawn instanced (submitInstances, submitArraysInstanced), a call per range of transforms.
+//
+// On GL 4.3 contexts the meshes can go through glMultiDrawElementsIndirect instead (setMultiDrawIndirect): runs of
+// sorted mesh draws that share program, VAO, material and state become one call, with their per draw uniforms
+// read from a shader storage buffer by the program registered with setIndirectProgram. needs a GL context
+class RenderQueue
+{
+public:
+    RenderQueue() = default;
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    ~RenderQueue()
+    {
+        if (indirectBuffer)
+        {
+            glDeleteBuffers(1, &indirectBuffer);
+            glDeleteBuffers(1, &drawDataBuffer);
+            glDeleteBuffers(1, &drawIdBuffer);
+        }
+    }
+
+    // camera for the depth part of the keys, depths are quantized over [0, farPlane]
+    void begin(const glm::vec3 &viewPosition, float farPlane)
+    {
+        this->viewPosition = viewPosition;
+        this->farPlane = farPlane;
+        items.clear();
+        commands.clear();
+        objects.clear();
+    }
+
+    // a model matrix for the draws submitted with the returned handle. parameters are any other per object values,
+    // the shaders read them as objectParameters
+    unsigned int addObject(const glm::mat4 &model, const glm::vec4 &parameters = glm::vec4(0.0f))
+    {
+        objects.push_back(Object{model, parameters});
+        return (unsigned int)objects.size() - 1;
+    }
+
+    // every mesh of the model left visible by Model::Cull
+    void submit(Model &model, Shader &shader, unsigned int object, RenderPass pass = RENDER_PASS_OPAQUE,
+                unsigned int state = RENDER_CULL_FACE)
+    {
+        const glm::mat4 &transform = objects[object].model;
+        for (Mesh &mesh : model.meshes)
+        {
+            if (!mesh.visible)
+                continue;
+            RenderCommand command;
+            command.shader = &shader;
+            command.object = object;
+            command.mesh = &mesh;
+            command.VAO = mesh.VAO;
+            command.material = mesh.material->id;
+            command.lod = mesh.lod;
+            command.state = state;
+            push(command, pass, glm::vec3(transform * glm::vec4(mesh.bounds.center, 1.0f)));
+        }
+    }
+
+    // a draw per range left by the last ModelInstances::update, with a shader that reads the instance matrix
+    // (see 2.model_lighting_instanced.vs). the object's model matrix applies on top of every instance's, it should be
+    // the one the instances were updated with
+    void submitInstances(const ModelInstances &instances, Shader &shader, unsigned int object, RenderPass pass = RENDER_PASS_OPAQUE,
+                         unsigned int state = RENDER_CULL_FACE)
+    {
+        for (const ModelInstances::Range &range : instances.ranges())
+        {
+            RenderCommand command;
+            command.shader = &shader;
+            command.object = object;
+            command.mesh = range.mesh;
+            command.VAO = range.mesh->VAO;
+            command.material = range.mesh->material->id;
+            command.lod = range.lod;
+            command.state = state;
+            command.instances = &instances.buffer();
+            command.firstInstance = range.first;
+            command.instanceCount = (GLsizei)range.count;
+            push(command, pass, range.nearest);
+        }
+    }
+
+    // a glDrawArrays of a hand made VAO with one texture, center is where it is in the world for the depth
+    void submitArrays(Shader &shader, unsigned int object, unsigned int VAO, GLenum textureTarget, unsigned int texture,
+                      GLenum mode, int first, int count, const glm::vec3 &center, RenderPass pass = RENDER_PASS_OPAQUE,
+                      unsigned int state = RENDER_CULL_FACE)
+    {
+        RenderCommand command;
+        command.shader = &shader;
+        command.object = object;
+        command.VAO = VAO;
+        command.textureTarget = textureTarget;
+        command.texture = texture;
+        command.material = texture;
+        command.mode = mode;
+        command.first = first;
+        command.count = count;
+        command.state = state;
+        push(command, pass, center);
+    }
+
+    // submitArrays drawn once per transform firstInstance to firstInstance + instanceCount of the buffer, the instances
+    // aren't sorted among themselves, upload them back to front for blending
+    void submitArraysInstanced(Shader &shader, unsigned int object, unsigned int VAO, GLenum textureTarget, unsigned int texture,
+                               GLenum mode, int first, int count, const InstanceBuffer &instances, size_t firstInstance,
+                               size_t instanceCount, const glm::vec3 &center, RenderPass pass = RENDER_PASS_OPAQUE,
+                               unsigned int state = RENDER_CULL_FACE)
+    {
+        submitArrays(shader, object, VAO, textureTarget, texture, mode, first, count, center, pass, state);
+        RenderCommand &command = commands.back();
+        command.instances = &instances;
+        command.firstInstance = firstInstance;
+        command.instanceCount = (GLsizei)instanceCount;
+    }
+
+    void sort()
+    {
+        radixSortRenderItems(items, scratch);
+    }
+
+    // the program mesh draws submitted with shader are issued with on the indirect path, it reads the per draw
+    // uniforms from the DrawData buffer. shaders without one keep being drawn a mesh at a time
+    void setIndirectProgram(Shader &shader, Shader &indirect)
+    {
+        indirectPrograms[&shader] = &indirect;
+    }
+
+    // turns the indirect path on, if the context has it (see detectGLFeatures)
+    void setMultiDrawIndirect(bool enabled)
+    {
+        indirect = enabled && glFeatures().multiDrawIndirect;
+    }
+
+    bool multiDrawIndirect() const
+    {
+        return indirect;
+    }
+
+    void execute()
+    {
+        stats = RenderQueueStats();
+        state = ExecuteState();
+        state.initialCullFace = state.cullFace = glIsEnabled(GL_CULL_FACE);
+        glActiveTexture(GL_TEXTURE0);
+
+        if (indirect)
+            executeIndirect();
+        else
+            for (const RenderItem &item : items)
+                issue(commands[item.command]);
+
+        glBindVertexArray(0);
+        if (state.cullFace != state.initialCullFace)
+        {
+            if (state.initialCullFace)
+                glEnable(GL_CULL_FACE);
+            else
+                glDisable(GL_CULL_FACE);
+        }
+    }
+
+    const RenderQueueStats &lastStats() const
+    {
+        return stats;
+    }
+
+private:
+    struct Object {
+        glm::mat4 model;
+        glm::vec4 parameters;
+    };
+
+    // what's bound while execute runs
+    struct ExecuteState {
+        Shader *program = nullptr;
+        Uniform<glm::mat4> modelMatrix;
+        Uniform<glm::vec4> objectParameters;
+        MeshUniforms meshUniforms;
+        unsigned int object = RENDER_NO_OBJECT, VAO = 0;
+        const Material *material = nullptr;  // the material whose textures are bound
+        unsigned int unit0Texture = 0;
+        GLenum unit0Target = GL_NONE;
+        bool initialCullFace = false, cullFace = false;
+    };
+
+    // consecutive sorted items drawn by one glMultiDrawElementsIndirect, or a single item drawn directly (count 0)
+    struct Batch {
+        size_t item;
+        size_t firstCommand;
+        GLsizei count;
+        GLenum primitive;
+        GLenum indexType;
+    };
+
+    vector<RenderItem> items, scratch;
+    vector<RenderCommand> commands;
+    vector<Object> objects;
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    float farPlane = 100.0f;
+    RenderQueueStats stats;
+    ExecuteState state;
+
+    // indirect path
+    bool indirect = false;
+    map<Shader *, Shader *> indirectPrograms;
+    vector<Batch> batches;
+    vector<DrawElementsIndirectCommand> indirectCommands;
+    vector<IndirectDrawData> drawData;
+    unsigned int indirectBuffer = 0, drawDataBuffer = 0, drawIdBuffer = 0;
+    size_t drawIdCapacity = 0;
+
+    void push(const RenderCommand &command, RenderPass pass, const glm::vec3 &center)
+    {
+        float distance = glm::length(center - viewPosition) / farPlane;
+        uint64_t depth = (uint64_t)(min(max(distance, 0.0f), 1.0f) * 0xFFFFFF);
+        uint64_t shader = command.shader->ID & 0xFF, material = command.material & 0xFFFF, vertexArray = command.VAO & 0x3FFF;
+        uint64_t key = (uint64_t)pass << 62;
+        if (pass == RENDER_PASS_TRANSPARENT)
+            key |= (0xFFFFFF - depth) << 38 | shader << 30 | material << 14 | vertexArray;
+        else
+            key |= shader << 54 | material << 38 | vertexArray << 24 | depth;
+        items.push_back(RenderItem{key, (unsigned int)commands.size()});
+        commands.push_back(command);
+    }
+
+    void useProgram(Shader *program)
+    {
+        if (program == state.program)
+            return;
+        state.program = program;
+        program->use();
+        state.modelMatrix = program->uniform<glm::mat4>("model");
+        state.objectParameters = program->uniform<glm::vec4>("objectParameters");
+        state.meshUniforms = MeshUniforms(*program);
+        // uniforms are per program, the next one hasn't seen this object. textures are bound per unit
+        // and the samplers of every program point at the same units, so the material stays bound
+        state.object = RENDER_NO_OBJECT;
+        stats.programChanges++;
+    }
+
+    void useObject(unsigned int object)
+    {
+        if (object == state.object || object == RENDER_NO_OBJECT)
+            return;
+        state.object = object;
+        state.modelMatrix.set(objects[object].model);
+        state.objectParameters.set(objects[object].parameters);
+        stats.objectChanges++;
+    }
+
+    void bindVertexArray(unsigned int VAO)
+    {
+        if (VAO == state.VAO)
+            return;
+        state.VAO = VAO;
+        glBindVertexArray(VAO);
+        stats.vertexArrayChanges++;
+    }
+
+    void setCullFace(unsigned int flags)
+    {
+        bool cull = (flags & RENDER_CULL_FACE) != 0;
+        if (cull == state.cullFace)
+            return;
+        state.cullFace = cull;
+        if (cull)
+            glEnable(GL_CULL_FACE);
+        else
+            glDisable(GL_CULL_FACE);
+    }
+
+    void bindMaterial(const Material *material)
+    {
+        if (material == state.material)
+            return;
+        state.material = material;
+        material->bind();
+        // bind() leaves unit 0 active, whether it had a texture for it or not
+        if (!material->bindings.empty() && material->bindings.back().unit == 0)
+        {
+            state.unit0Texture = material->bindings.back().texture;
+            state.unit0Target = material->bindings.back().target;
+        }
+        stats.materialChanges++;
+    }
+
+    // a draw on its own, with the program it was submitted with
+    void issue(const RenderCommand &command)
+    {
+        useProgram(command.shader);
+        useObject(command.object);
+        bindVertexArray(command.VAO);
+        setCullFace(command.state);
+        if (command.instances)
+            command.instances->bindAttributes(command.firstInstance);
+        if (command.mesh)
+        {
+            bindMaterial(command.mesh->material);
+            command.mesh->DrawGeometry(state.meshUniforms, command.lod, command.instanceCount);
+        }
+        else
+        {
+            if (command.texture != state.unit0Texture || command.textureTarget != state.unit0Target)
+            {
+                glBindTexture(command.textureTarget, command.texture);
+                state.unit0Texture = command.texture;
+                state.unit0Target = command.textureTarget;
+                state.material = nullptr;
+                stats.materialChanges++;
+            }
+            if (command.instances)
+                glDrawArraysInstanced(command.mode, command.first, command.count, command.instanceCount);
+            else
+                glDrawArrays(command.mode, command.first, command.count);
+        }
+        if (command.instances)
+            InstanceBuffer::unbindAttributes();
+        stats.draws++;
+        stats.drawCalls++;
+        stats.instances += command.instanceCount;
+    }
+
+    Shader *indirectProgram(Shader *shader) const
+    {
+        auto found = indirectPrograms.find(shader);
+        return found == indirectPrograms.end() ? nullptr : found->second;
+    }
+
+    // splits the sorted items into batches, writes their commands and draw data, uploads both and issues the batches
+    void executeIndirect()
+    {
+        batches.clear();
+        indirectCommands.clear();
+        drawData.clear();
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const RenderCommand &command = commands[items[i].command];
+            // instanced draws already are a single call
+            if (!command.mesh || command.instances || !indirectProgram(command.shader))
+            {
+                batches.push_back(Batch{i, 0, 0, GL_NONE, GL_NONE});
+                continue;
+            }
+            const Mesh &mesh = *command.mesh;
+            const GeometryAllocation &drawn = mesh.levelGeometry(command.lod);
+            bool extends = false;
+            if (!batches.empty() && batches.back().count > 0)
+            {
+                const Batch &batch = batches.back();
+                const RenderCommand &first = commands[items[batch.item].command];
+                extends = first.shader == command.shader && first.VAO == command.VAO && first.state == command.state
+                          && first.mesh->material == mesh.material && batch.primitive == drawn.primitive
+                          && batch.indexType == drawn.indexType;
+            }
+            if (!extends)
+                batches.push_back(Batch{i, indirectCommands.size(), 0, drawn.primitive, drawn.indexType});
+            batches.back().count++;
+
+            DrawElementsIndirectCommand draw;
+            draw.count = drawn.indexCount;
+            draw.instanceCount = 1;
+            draw.firstIndex = (GLuint)(drawn.indexOffset / (drawn.indexType == GL_UNSIGNED_SHORT ? 2 : 4));
+            draw.baseVertex = (GLint)drawn.firstVertex;
+            draw.baseInstance = (GLuint)drawData.size();
+            indirectCommands.push_back(draw);
+
+            IndirectDrawData data;
+            bool hasObject = command.object != RENDER_NO_OBJECT;
+            data.model = hasObject ? objects[command.object].model : glm::mat4(1.0f);
+            data.parameters = hasObject ? objects[command.object].parameters : glm::vec4(0.0f);
+            data.textureLayers = mesh.textureLayers;
+            bool packed = mesh.vertexFormat == VERTEX_FORMAT_PACKED;
+            data.positionScale = glm::vec4(mesh.positionScale.x, mesh.positionScale.y, mesh.positionScale.z, packed ? 1.0f : 0.0f);
+            data.positionOffset = glm::vec4(mesh.positionOffset.x, mesh.positionOffset.y, mesh.positionOffset.z, 0.0f);
+            drawData.push_back(data);
+        }
+        uploadIndirect();
+
+        for (const Batch &batch : batches)
+        {
+            const RenderCommand &command = commands[items[batch.item].command];
+            if (batch.count == 0)
+            {
+                issue(command);
+                continue;
+            }
+            useProgram(indirectProgram(command.shader));
+            bindVertexArray(command.VAO);
+            setCullFace(command.state);
+            bindMaterial(command.mesh->material);
+            if (batch.primitive == GL_TRIANGLE_STRIP)
+            {
+                glEnable(GL_PRIMITIVE_RESTART);
+                glPrimitiveRestartIndex(batch.indexType == GL_UNSIGNED_SHORT ? 0xFFFF : 0xFFFFFFFF);
+            }
+            // only the indirect draws read the draw id, direct and instanced draws of the VAO leave it disabled
+            glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+            glFeatures().multiDrawElementsIndirect(batch.primitive, batch.indexType,
+                                                   (void *)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                                   batch.count, 0);
+            glDisableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+            if (batch.primitive == GL_TRIANGLE_STRIP)
+                glDisable(GL_PRIMITIVE_RESTART);
+            stats.draws += batch.count;
+            stats.drawCalls++;
+            stats.instances += batch.count;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // the commands go to the draw indirect buffer, which stays bound for the batches, and the draw data to the storage
+    // buffer. the draw id buffer only holds 0, 1, 2... and is rewritten when more draws than it holds come in
+    void uploadIndirect()
+    {
+        if (!indirectBuffer)
+        {
+            glGenBuffers(1, &indirectBuffer);
+            glGenBuffers(1, &drawDataBuffer);
+            glGenBuffers(1, &drawIdBuffer);
+        }
+        if (drawData.size() > drawIdCapacity)
+        {
+            drawIdCapacity = max(drawIdCapacity * 2, max(drawData.size(), (size_t)1024));
+            vector<GLuint> ids(drawIdCapacity);
+            for (size_t i = 0; i < ids.size(); i++)
+                ids[i] = (GLuint)i;
+            glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+            glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            GeometryPool::shared().setDrawIdBuffer(drawIdBuffer);
+            state.VAO = 0;
+        }
+
+        // fresh storage every frame, so the driver never waits for the draws of the last one
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+                     indirectCommands.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(IndirectDrawData), drawData.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_DATA_BINDING, drawDataBuffer);
+    }
+};
+#endif
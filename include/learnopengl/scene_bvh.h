@@ -0,0 +1,371 @@
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/model.h>
+#include <learnopengl/occlusion.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// push out iterations per step of a sphere sweep, each resolves every contact found once
+const int SWEEP_ITERATIONS = 4;
+// occluders are simplified down to about this many triangles per mesh
+const size_t OCCLUDER_MESH_TRIANGLES = 512;
+// and may move at most this far from the mesh, relative to its radius. further would hide what's just behind it
+const float OCCLUDER_MAX_ERROR = 0.02f;
+
+// what an object added to the scene takes part in besides culling and picking
+enum SceneObjectFlags {
+    SCENE_COLLISION = 1,  // the camera can't move through it
+    SCENE_OCCLUDER = 2    // rasterized into the occlusion buffer to hide what's behind it
+};
+
+// Möller-Trumbore, both sides count as a hit
+bool intersectRayTriangle(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &a, const glm::vec3 &b,
+                          const glm::vec3 &c, float &t)
+{
+    glm::vec3 edge1 = b - a, edge2 = c - a, p = glm::cross(direction, edge2);
+    float determinant = glm::dot(edge1, p);
+    if (fabs(determinant) < 1e-12f)
+        return false;
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    t = glm::dot(edge2, q) * inverse;
+    return t >= 0.0f;
+}
+
+// closest point to p on the triangle abc, by the voronoi region p falls in (Ericson, Real-Time Collision Detection 5.1.5)
+glm::vec3 closestPointOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return a;
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return b;
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return a + ab * (d1 / (d1 - d3));
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return c;
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return a + ac * (d2 / (d2 - d6));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    float denominator = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// world space triangles of a static model with a BVH over them, for picking and collision
+class TriangleBvh
+{
+public:
+    // needs the model's CPU geometry, see Model::SetKeepCpuData
+    void build(const Model &model, const glm::mat4 &transform)
+    {
+        triangles.clear();
+        for (const Mesh &mesh : model.meshes)
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+                for (int k = 0; k < 3; k++)
+                    triangles.push_back(glm::vec3(transform * glm::vec4(mesh.vertices[mesh.indices[i + k]].Position, 1.0f)));
+
+        vector<Aabb> bounds(triangles.size() / 3);
+        for (size_t t = 0; t < bounds.size(); t++)
+            for (int k = 0; k < 3; k++)
+                bounds[t].grow(triangles[t * 3 + k]);
+        bvh.build(bounds);
+    }
+
+    bool empty() const
+    {
+        return triangles.empty();
+    }
+
+    // nearest hit along the ray closer than maxT, which is lowered to it
+    bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, float &maxT) const
+    {
+        bool hit = false;
+        bvh.queryRay(origin, direction, maxT, [&](unsigned int triangle, float &closest) {
+            float t;
+            if (intersectRayTriangle(origin, direction, triangles[triangle * 3], triangles[triangle * 3 + 1],
+                                     triangles[triangle * 3 + 2], t) && t < closest)
+            {
+                closest = t;
+                hit = true;
+            }
+        });
+        return hit;
+    }
+
+    // moves a sphere out of the triangles it intersects. a center behind a triangle's front face is pushed
+    // to the front, so a sphere can't slip through a surface it got within one radius of.
+    // returns true if the sphere was moved
+    bool pushOut(glm::vec3 &center, float radius) const
+    {
+        bool moved = false;
+        Aabb box(center - glm::vec3(radius), center + glm::vec3(radius));
+        bvh.queryAabb(box, [&](unsigned int triangle) {
+            const glm::vec3 &a = triangles[triangle * 3], &b = triangles[triangle * 3 + 1], &c = triangles[triangle * 3 + 2];
+            glm::vec3 closest = closestPointOnTriangle(center, a, b, c), offset = center - closest;
+            float distanceSquared = glm::dot(offset, offset);
+            if (distanceSquared >= radius * radius)
+                return;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float normalLength = glm::length(normal);
+            if (normalLength == 0.0f)
+                return;
+            normal /= normalLength;
+            float distance = sqrt(distanceSquared);
+            glm::vec3 direction = distance > 1e-6f ? offset / distance : normal;
+            if (glm::dot(offset, normal) < 0.0f)
+                direction = normal;
+            center = closest + direction * radius;
+            moved = true;
+        });
+        return moved;
+    }
+
+private:
+    vector<glm::vec3> triangles;  // three corners per triangle
+    Bvh bvh;
+};
+
+// The objects of the scene in a BVH: culls whole models before their meshes are looked at, finds what's under the
+// mouse, and keeps the camera out of the objects added with collision. Models load asynchronously, so update()
+// picks up their bounds (and builds their triangles) once they're loaded.
+// culling can also run the occluders through an OcclusionBuffer and drop the objects they hide.
+class SceneBvh : public CameraCollider
+{
+public:
+    // returns the object's handle. flags are SceneObjectFlags, collision and occluders need the model's CPU
+    // geometry (Model::SetKeepCpuData)
+    int add(const string &name, Model &model, const glm::mat4 &transform, unsigned int flags = 0)
+    {
+        unique_ptr<Object> object(new Object());
+        object->name = name;
+        object->model = &model;
+        object->transform = transform;
+        object->flags = flags;
+        objects.push_back(move(object));
+        dirty = true;
+        return (int)objects.size() - 1;
+    }
+
+    // moving an object refits the tree, its triangles (if any) are rebuilt
+    void setTransform(int object, const glm::mat4 &transform)
+    {
+        Object &target = *objects[object];
+        if (target.transform == transform)
+            return;
+        target.transform = transform;
+        target.triangles.reset();
+        target.occluder.clear();
+        if (!dirty)
+            bvh.refit((unsigned int)object, worldBounds(target));
+    }
+
+    // call once per frame before querying
+    void update()
+    {
+        for (auto &object : objects)
+        {
+            if (!object->loaded && object->model->isLoaded())
+            {
+                object->loaded = true;
+                dirty = true;
+            }
+            if (object->loaded && (object->flags & SCENE_COLLISION) && !object->triangles)
+            {
+                object->triangles.reset(new TriangleBvh());
+                object->triangles->build(*object->model, object->transform);
+                if (object->triangles->empty())
+                    cout << "ERROR::SCENE:: " << object->name << " has no CPU geometry to collide with" << endl;
+            }
+            if (object->loaded && (object->flags & SCENE_OCCLUDER) && object->occluder.empty())
+            {
+                buildOccluder(*object);
+                if (object->occluder.empty())
+                {
+                    cout << "ERROR::SCENE:: " << object->name << " has no CPU geometry to occlude with" << endl;
+                    object->flags &= ~SCENE_OCCLUDER;
+                }
+            }
+        }
+        if (!dirty)
+            return;
+        // an object that just loaded grows from nothing, rebuild instead of refitting
+        vector<Aabb> bounds;
+        for (const auto &object : objects)
+            bounds.push_back(worldBounds(*object));
+        bvh.build(bounds, 1);
+        dirty = false;
+    }
+
+    // hierarchical frustum culling, afterwards isVisible tells which objects are in view. with an occlusion buffer
+    // the occluders in view are rasterized into it and the objects behind them are culled too
+    size_t cull(const glm::mat4 &projectionView, OcclusionBuffer *occlusion = nullptr)
+    {
+        for (auto &object : objects)
+            object->visible = false;
+        size_t visible = 0;
+        bvh.queryFrustum(Frustum::fromMatrix(projectionView), [&](unsigned int object, bool) {
+            objects[object]->visible = true;
+            visible++;
+        });
+        if (!occlusion)
+            return visible;
+
+        occlusion->begin(projectionView);
+        for (const auto &object : objects)
+            if (object->visible && (object->flags & SCENE_OCCLUDER))
+                occlusion->addOccluder(object->occluder);
+        occlusion->rasterize();
+        for (unsigned int i = 0; i < objects.size(); i++)
+        {
+            if (objects[i]->visible && !occlusion->isVisible(bvh.bounds(i)))
+            {
+                objects[i]->visible = false;
+                visible--;
+            }
+        }
+        return visible;
+    }
+
+    bool isVisible(int object) const
+    {
+        return objects[object]->visible;
+    }
+
+    const string &name(int object) const
+    {
+        return objects[object]->name;
+    }
+
+    // nearest object hit by the ray, -1 if none. objects with triangles are hit exactly, the others by their meshes' boxes
+    int pick(const glm::vec3 &origin, const glm::vec3 &direction, float &distance) const
+    {
+        int picked = -1;
+        distance = numeric_limits<float>::max();
+        bvh.queryRay(origin, direction, distance, [&](unsigned int index, float &closest) {
+            const Object &object = *objects[index];
+            if (object.triangles && !object.triangles->empty())
+            {
+                if (object.triangles->raycast(origin, direction, closest))
+                    picked = (int)index;
+                return;
+            }
+            // boxes are tested in model space
+            glm::mat4 inverse = glm::inverse(object.transform);
+            glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f)), localDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+            glm::vec3 inverseDirection(1.0f / localDirection.x, 1.0f / localDirection.y, 1.0f / localDirection.z);
+            for (const Mesh &mesh : object.model->meshes)
+            {
+                float t;
+                // t is the same along both rays, localDirection is direction transformed
+                if (intersectRayAabb(localOrigin, inverseDirection, Aabb(mesh.bounds.min, mesh.bounds.max), closest, t) && t < closest)
+                {
+                    closest = t;
+                    picked = (int)index;
+                }
+            }
+        });
+        return picked;
+    }
+
+    // moves the sphere in steps of at most half its radius, pushing it out of the triangles of collision objects
+    // after each step, which makes it slide along them instead of passing through
+    glm::vec3 sweepSphere(const glm::vec3 &from, const glm::vec3 &to, float radius) const override
+    {
+        glm::vec3 motion = to - from;
+        int steps = max(1, (int)ceil(glm::length(motion) / (radius * 0.5f)));
+        glm::vec3 center = from;
+        for (int step = 0; step < steps; step++)
+        {
+            center += motion / (float)steps;
+            for (int iteration = 0; iteration < SWEEP_ITERATIONS; iteration++)
+            {
+                bool moved = false;
+                Aabb box(center - glm::vec3(radius), center + glm::vec3(radius));
+                bvh.queryAabb(box, [&](unsigned int index) {
+                    const Object &object = *objects[index];
+                    if (object.triangles)
+                        moved |= object.triangles->pushOut(center, radius);
+                });
+                if (!moved)
+                    break;
+            }
+        }
+        return center;
+    }
+
+private:
+    struct Object {
+        string name;
+        Model *model = nullptr;
+        glm::mat4 transform = glm::mat4(1.0f);
+        unsigned int flags = 0;
+        bool loaded = false;
+        bool visible = false;
+        unique_ptr<TriangleBvh> triangles;
+        vector<glm::vec3> occluder;  // world space triangles, three corners each
+    };
+
+    vector<unique_ptr<Object>> objects;
+    Bvh bvh;
+    bool dirty = false;
+
+    // the object's meshes, simplified, in world space for the occlusion buffer. the error is kept small, any of it
+    // can make the occluder hide more than it should
+    static void buildOccluder(Object &object)
+    {
+        vector<unsigned int> indices;
+        for (const Mesh &mesh : object.model->meshes)
+        {
+            if (mesh.indices.size() / 3 > OCCLUDER_MESH_TRIANGLES)
+                simplifyMesh(mesh.vertices, mesh.indices, OCCLUDER_MESH_TRIANGLES * 3, OCCLUDER_MAX_ERROR * mesh.bounds.radius, indices);
+            else
+                indices = mesh.indices;
+            for (unsigned int index : indices)
+                object.occluder.push_back(glm::vec3(object.transform * glm::vec4(mesh.vertices[index].Position, 1.0f)));
+        }
+    }
+
+    // union of the meshes' boxes in world space, a point at the origin of the object until it's loaded
+    static Aabb worldBounds(const Object &object)
+    {
+        Aabb bounds;
+        for (const Mesh &mesh : object.model->meshes)
+            bounds.grow(Aabb(mesh.bounds.min, mesh.bounds.max).transformed(object.transform));
+        if (bounds.empty())
+        {
+            glm::vec3 origin = glm::vec3(object.transform[3]);
+            bounds = Aabb(origin, origin);
+        }
+        return bounds;
+    }
+};
+#endif
@@ -0,0 +1,134 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+using namespace std;
+
+const int SCENE_NO_PARENT = -1;
+
+// A hierarchy of transforms. every node has a local transform relative to its parent, and a world transform that
+// update() keeps as parent world * local. nodes live in contiguous arrays indexed by their handle, parents are added
+// before their children. setLocal only marks the node dirty, update() then recomputes the dirty subtrees and
+// nothing else, so a frame where nothing moved costs nothing
+class SceneGraph
+{
+public:
+    // returns the node's handle, its world transform is valid after the next update()
+    int add(const glm::mat4 &local, int parent = SCENE_NO_PARENT, const string &name = string())
+    {
+        int node = (int)locals.size();
+        locals.push_back(local);
+        worlds.push_back(local);
+        parents.push_back(parent);
+        firstChildren.push_back(SCENE_NO_PARENT);
+        nextSiblings.push_back(SCENE_NO_PARENT);
+        depths.push_back(parent == SCENE_NO_PARENT ? 0 : depths[parent] + 1);
+        names.push_back(name);
+        dirty.push_back(0);
+        if (parent != SCENE_NO_PARENT)
+        {
+            nextSiblings[node] = firstChildren[parent];
+            firstChildren[parent] = node;
+        }
+        markDirty(node);
+        return node;
+    }
+
+    // a transform that didn't change leaves the node clean
+    void setLocal(int node, const glm::mat4 &local)
+    {
+        if (locals[node] == local)
+            return;
+        locals[node] = local;
+        markDirty(node);
+    }
+
+    // recomputes the world transforms of the dirty nodes and everything below them, afterwards changed() lists them.
+    // shallow nodes go first, a dirty node inside a subtree that was already recomputed is skipped
+    size_t update()
+    {
+        changedNodes.clear();
+        if (dirtyNodes.empty())
+            return 0;
+        stable_sort(dirtyNodes.begin(), dirtyNodes.end(), [&](int a, int b) { return depths[a] < depths[b]; });
+        for (int root : dirtyNodes)
+        {
+            if (!dirty[root])
+                continue;
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                int node = stack.back();
+                stack.pop_back();
+                int parent = parents[node];
+                worlds[node] = parent == SCENE_NO_PARENT ? locals[node] : worlds[parent] * locals[node];
+                dirty[node] = 0;
+                changedNodes.push_back(node);
+                for (int child = firstChildren[node]; child != SCENE_NO_PARENT; child = nextSiblings[child])
+                    stack.push_back(child);
+            }
+        }
+        dirtyNodes.clear();
+        return changedNodes.size();
+    }
+
+    // nodes whose world transform the last update() recomputed
+    const vector<int> &changed() const
+    {
+        return changedNodes;
+    }
+
+    const glm::mat4 &local(int node) const
+    {
+        return locals[node];
+    }
+
+    const glm::mat4 &world(int node) const
+    {
+        return worlds[node];
+    }
+
+    int parent(int node) const
+    {
+        return parents[node];
+    }
+
+    const string &name(int node) const
+    {
+        return names[node];
+    }
+
+    // first node with the name, SCENE_NO_PARENT if there is none
+    int find(const string &name) const
+    {
+        for (size_t node = 0; node < names.size(); node++)
+            if (names[node] == name)
+                return (int)node;
+        return SCENE_NO_PARENT;
+    }
+
+    size_t size() const
+    {
+        return locals.size();
+    }
+
+private:
+    vector<glm::mat4> locals, worlds;
+    vector<int> parents, firstChildren, nextSiblings, depths;
+    vector<string> names;
+    vector<unsigned char> dirty;
+    vector<int> dirtyNodes, changedNodes, stack;
+
+    void markDirty(int node)
+    {
+        if (dirty[node])
+            return;
+        dirty[node] = 1;
+        dirtyNodes.push_back(node);
+    }
+};
+#endif
@@ -4,66 +4,81 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <learnopengl/hash.h>
+#include <learnopengl/vfs.h>
+
+#include <cstdint>
+#include <cstring>
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <vector>
 #include <common.h>
+
+// A uniform name as its hash. literals go through the constexpr hashName, so with optimizations on (or in a constexpr
+// UniformName) they cost nothing at run time, names built at run time are hashed when converted.
+struct UniformName {
+    uint64_t hash;
+
+    template <size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(hashName(name)) {}
+    UniformName(const std::string &name) : hash(hashName(name.c_str())) {}
+    explicit constexpr UniformName(uint64_t hash) : hash(hash) {}
+};
+
+// glUniform* for each type a uniform can be set from, on the program in use
+inline void setUniform(GLint location, bool value) { glUniform1i(location, (int)value); }
+inline void setUniform(GLint location, int value) { glUniform1i(location, value); }
+inline void setUniform(GLint location, float value) { glUniform1f(location, value); }
+inline void setUniform(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+inline void setUniform(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void setUniform(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void setUniform(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+// A uniform location resolved once (see Shader::uniform), setting it is a single glUniform call on the program in use.
+// uniforms the program doesn't have get location -1, which GL ignores
+template <typename T>
+class Uniform
+{
+public:
+    GLint location = -1;
+
+    Uniform() {}
+    explicit Uniform(GLint location) : location(location) {}
+
+    void set(const T &value) const
+    {
+        setUniform(location, value);
+    }
+
+    bool valid() const
+    {
+        return location >= 0;
+    }
+};
+
 class Shader
 {
 public:
     unsigned int ID;
+    // bit i is set when the program reads the vertex attribute at location i
+    unsigned int attributeMask = 0;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
+        // 1. retrieve the vertex/fragment source code from filePath, through the VirtualFileSystem
+        VirtualFileSystem &vfs = VirtualFileSystem::shared();
+        FileView vShaderFile = vfs.open(vertexPath);
+        FileView fShaderFile = vfs.open(fragmentPath);
+        // if geometry shader path is present, also load a geometry shader
+        FileView gShaderFile = geometryPath != nullptr ? vfs.open(geometryPath) : FileView::fromBuffer({});
+        if (!vShaderFile.valid() || !fShaderFile.valid() || !gShaderFile.valid())
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-        }
+        std::string vertexCode = resolveIncludes(vShaderFile.str(), vertexPath);
+        std::string fragmentCode = resolveIncludes(fShaderFile.str(), fragmentPath);
+        std::string geometryCode = geometryPath != nullptr ? resolveIncludes(gShaderFile.str(), geometryPath) : std::string();
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -101,7 +116,8 @@ public:
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        findActiveAttributes();
+        findActiveUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -109,66 +125,206 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // location of a uniform from the table built at link time, no GL call. -1 if the program doesn't have it
+    GLint location(const UniformName &name) const
+    {
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = name.hash & mask;; i = (i + 1) & mask)
+        {
+            if (uniformTable[i].hash == name.hash)
+                return uniformTable[i].location;
+            if (uniformTable[i].hash == 0)
+                return -1;
+        }
+    }
+    // a handle for setting a uniform without looking it up again
+    template <typename T>
+    Uniform<T> uniform(const UniformName &name) const
+    {
+        return Uniform<T>(location(name));
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const UniformName &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const UniformName &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const UniformName &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setUniform(location(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const UniformName &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setUniform(location(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const UniformName &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(location(name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const UniformName &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setUniform(location(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const UniformName &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const UniformName &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setUniform(location(name), value);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(const UniformName &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const UniformName &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const UniformName &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const UniformName &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setUniform(location(name), mat);
     }
 
 private:
+    // GLSL 3.30 has no includes: every '#include "file"' line is replaced by the file, found next to the including
+    // shader through the VirtualFileSystem. included files may include others, up to a few levels deep
+    // ------------------------------------------------------------------------
+    static std::string resolveIncludes(const std::string &source, const std::string &path, int depth = 0)
+    {
+        const int MAX_INCLUDE_DEPTH = 8;
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::string resolved;
+        size_t start = 0;
+        while (start < source.size())
+        {
+            size_t end = source.find('\n', start);
+            end = end == std::string::npos ? source.size() : end + 1;
+            std::string line = source.substr(start, end - start);
+            start = end;
+            size_t directive = line.find_first_not_of(" \t");
+            size_t open = line.find('"'), close = line.rfind('"');
+            if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0 || open == close)
+            {
+                resolved += line;
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            FileView included = VirtualFileSystem::shared().open(includePath);
+            if (!included.valid() || depth >= MAX_INCLUDE_DEPTH)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_RESOLVED: " << includePath << " in " << path << std::endl;
+                continue;
+            }
+            resolved += resolveIncludes(included.str(), includePath, depth + 1);
+            if (resolved.empty() || resolved.back() != '\n')
+                resolved += '\n';
+        }
+        return resolved;
+    }
+
+    // records which attribute locations the linked program actually consumes
+    // ------------------------------------------------------------------------
+    void findActiveAttributes()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(ID, i, sizeof(name), NULL, &size, &type, name);
+            GLint location = glGetAttribLocation(ID, name);
+            // built in inputs like gl_VertexID have no location
+            if (location >= 0 && location < 32)
+                attributeMask |= 1u << location;
+        }
+    }
+
+    struct UniformSlot {
+        uint64_t hash;
+        GLint location;
+    };
+    // open addressing on the name hashes, at most half full. hash 0 marks an empty slot
+    std::vector<UniformSlot> uniformTable = std::vector<UniformSlot>(16, UniformSlot{0, -1});
+    size_t uniformCount = 0;
+
+    // resolves every active uniform into uniformTable. arrays are found as "name", "name[0]", "name[1]"...
+    // uniforms in blocks have no location and are left out
+    // ------------------------------------------------------------------------
+    void findActiveUniforms()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLsizei length;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, i, sizeof(name), &length, &size, &type, name);
+            GLint location = glGetUniformLocation(ID, name);
+            if (location < 0)
+                continue;
+            addUniform(name, location);
+            if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+            {
+                std::string base(name, length - 3);
+                addUniform(base.c_str(), location);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    addUniform(elementName.c_str(), glGetUniformLocation(ID, elementName.c_str()));
+                }
+            }
+        }
+    }
+
+    void addUniform(const char *name, GLint location)
+    {
+        if ((uniformCount + 1) * 2 > uniformTable.size())
+        {
+            std::vector<UniformSlot> old(uniformTable.size() * 2, UniformSlot{0, -1});
+            old.swap(uniformTable);
+            for (const UniformSlot &slot : old)
+                if (slot.hash != 0)
+                    insertUniform(slot.hash, slot.location);
+        }
+        if (!insertUniform(hashName(name), location))
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << name << std::endl;
+    }
+
+    // false if a uniform with another location already has the hash
+    bool insertUniform(uint64_t hash, GLint location)
+    {
+        size_t mask = uniformTable.size() - 1;
+        size_t i = hash & mask;
+        while (uniformTable[i].hash != 0 && uniformTable[i].hash != hash)
+            i = (i + 1) & mask;
+        if (uniformTable[i].hash == hash)
+            return uniformTable[i].location == location;
+        uniformTable[i] = UniformSlot{hash, location};
+        uniformCount++;
+        return true;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,399 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/vfs.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+// default per frame time budget for TextureStreamer::processUploads
+const double TEXTURE_UPLOAD_BUDGET_MS = 2.0;
+
+// decoded 8 bit image, as returned by stb_image
+struct Image {
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, stbi_image_free};
+
+    bool valid() const
+    {
+        return pixels != nullptr;
+    }
+
+    size_t size() const
+    {
+        return (size_t)width * height * components;
+    }
+};
+
+void flipImageVertically(Image &image)
+{
+    size_t stride = (size_t)image.width * image.components;
+    vector<unsigned char> row(stride);
+    unsigned char *pixels = image.pixels.get();
+    for (int y = 0; y < image.height / 2; y++)
+    {
+        unsigned char *top = pixels + y * stride;
+        unsigned char *bottom = pixels + (image.height - 1 - y) * stride;
+        memcpy(row.data(), top, stride);
+        memcpy(top, bottom, stride);
+        memcpy(bottom, row.data(), stride);
+    }
+}
+
+// decodes an image file that is already in memory. Safe to call from worker threads: stb_image's global flip flag
+// is never used, the image is flipped here instead when flipVertically is set.
+bool loadImageFromMemory(const FileView &contents, bool flipVertically, Image &image)
+{
+    image.pixels.reset(stbi_load_from_memory(contents.data(), (int)contents.size(), &image.width, &image.height, &image.components, 0));
+    if (!image.valid())
+        return false;
+    if (flipVertically)
+        flipImageVertically(image);
+    return true;
+}
+
+// same as loadImageFromMemory, for a file opened through the VirtualFileSystem
+bool loadImage(const string &path, bool flipVertically, Image &image)
+{
+    FileView contents = VirtualFileSystem::shared().open(path);
+    return contents.valid() && loadImageFromMemory(contents, flipVertically, image);
+}
+
+// Streams textures in the background: files are decoded on the thread pool and copied to the GPU on the GL thread
+// through a small ring of pixel buffer objects, a slice of rows at a time, with the time spent per frame capped by a budget.
+// load returns a texture id right away, which samples a 1x1 placeholder until the whole image has arrived.
+//
+// Mip chains are built on the worker threads (see mipmap.h) and, unless compression is turned off, block compressed
+// (see texture_compression.h). Finished chains are kept in the texture cache, so later runs skip decoding, filtering
+// and encoding, and just upload the precomputed levels, smallest level first.
+class TextureStreamer
+{
+public:
+    TextureStreamer(ThreadPool &pool = ThreadPool::shared()) : pool(pool), decoded(make_shared<DecodeQueue>())
+    {
+    }
+
+    TextureStreamer(const TextureStreamer &) = delete;
+    TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+    // streamer used by TextureFromFile and the texture loaders in main
+    static TextureStreamer &shared()
+    {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    // starts loading a mipmapped, repeating 2D texture. Must be called on the GL thread.
+    // contents, when valid, is the already opened file, which is then decoded instead of opening path again.
+    // usage picks the compressed format.
+    unsigned int load(const string &path, bool flipVertically, FileView contents = FileView(),
+                      TextureUsage usage = TEXTURE_USAGE_COLOR)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        setPlaceholder(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        decode(textureID, GL_TEXTURE_2D, path, flipVertically, contents, usage);
+        return textureID;
+    }
+
+    // starts loading a cubemap, faces are given in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order and decoded in parallel.
+    // contents optionally holds the already opened files, in the same order.
+    unsigned int loadCubemap(const vector<string> &faces, bool flipVertically, const vector<FileView> &contents = {})
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            setPlaceholder(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+            decode(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], flipVertically,
+                   i < contents.size() ? contents[i] : FileView(), TEXTURE_USAGE_COLOR);
+        }
+        return textureID;
+    }
+
+    // uploads finished mip chains until budgetMilliseconds is used up (at least one slice per call, so uploads always progress).
+    // must be called on the GL thread, once per frame.
+    void processUploads(double budgetMilliseconds = TEXTURE_UPLOAD_BUDGET_MS)
+    {
+        {
+            lock_guard<mutex> lock(decoded->queueMutex);
+            while (!decoded->jobs.empty())
+            {
+                uploading.push_back(move(decoded->jobs.front()));
+                decoded->jobs.pop_front();
+            }
+        }
+        if (uploading.empty())
+            return;
+
+        auto start = chrono::steady_clock::now();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        do
+        {
+            UploadJob &job = uploading.front();
+            // the texture of a cancelled job may be gone already, drop the job without touching GL
+            if (cancelled.count(job.textureID) || uploadSlice(job))
+            {
+                finish(job.textureID);
+                uploading.pop_front();
+            }
+        }
+        while (!uploading.empty()
+               && chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() < budgetMilliseconds);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // number of images (cubemap faces count separately) that are still being decoded or uploaded
+    unsigned int pending() const
+    {
+        return requested - completed;
+    }
+
+    // whether images of the texture are still being decoded or uploaded, deleting it before then would have the
+    // streamer upload into a dead (or reused) name
+    bool streaming(unsigned int textureID) const
+    {
+        return outstanding.count(textureID) != 0;
+    }
+
+    // drops the texture's remaining jobs as they come up, it can be deleted once streaming returns false.
+    // must be called on the GL thread
+    void cancel(unsigned int textureID)
+    {
+        if (streaming(textureID))
+            cancelled.insert(textureID);
+    }
+
+    // only affects textures loaded afterwards
+    void setCompressionEnabled(bool enabled)
+    {
+        compression = enabled;
+    }
+
+    bool compressionEnabled() const
+    {
+        return compression;
+    }
+
+    // number of images whose mip chain came from the texture cache
+    unsigned int cacheHits() const
+    {
+        return decoded->cacheHits;
+    }
+
+private:
+    static const size_t PIXEL_BUFFER_SIZE = 4 * 1024 * 1024;
+    static const int PIXEL_BUFFER_COUNT = 3;
+
+    struct UploadJob {
+        unsigned int textureID;
+        GLenum target;       // GL_TEXTURE_2D or one of the cubemap faces
+        string path;
+        MipChain texture;
+        int level = -1;      // level being uploaded
+        int rowsUploaded = 0;
+    };
+
+    // decoded images are handed over through a shared queue, so decode jobs still running at exit never outlive it
+    struct DecodeQueue {
+        mutex queueMutex;
+        deque<UploadJob> jobs;
+        atomic<unsigned int> cacheHits{0};
+    };
+
+    ThreadPool &pool;
+    shared_ptr<DecodeQueue> decoded;
+
+    // only touched on the GL thread
+    deque<UploadJob> uploading;
+    unsigned int pixelBuffers[PIXEL_BUFFER_COUNT] = {};
+    int nextPixelBuffer = 0;
+    unsigned int requested = 0;
+    unsigned int completed = 0;
+    bool compression = true;
+    unordered_map<unsigned int, unsigned int> outstanding;  // jobs per texture not finished or dropped yet
+    unordered_set<unsigned int> cancelled;
+
+    void decode(unsigned int textureID, GLenum target, const string &path, bool flipVertically,
+                FileView contents, TextureUsage usage)
+    {
+        requested++;
+        outstanding[textureID]++;
+        shared_ptr<DecodeQueue> queue = decoded;
+        bool compress = compression;
+        bool allowS3TC = compress && hasS3TCSupport();
+        pool.enqueue([queue, textureID, target, path, flipVertically, contents, usage, compress, allowS3TC] {
+            UploadJob job;
+            job.textureID = textureID;
+            job.target = target;
+            job.path = path;
+            FileView file = contents.valid() ? contents : VirtualFileSystem::shared().open(path);
+            if (!file.valid() || !prepareTexture(file, flipVertically, usage, target == GL_TEXTURE_2D, compress, allowS3TC, *queue, job))
+                std::cout << "Texture failed to load at path: " << path << std::endl;
+
+            lock_guard<mutex> lock(queue->queueMutex);
+            queue->jobs.push_back(move(job));
+        });
+    }
+
+    // a job is done with its texture, uploaded or dropped
+    void finish(unsigned int textureID)
+    {
+        completed++;
+        auto found = outstanding.find(textureID);
+        if (--found->second == 0)
+        {
+            outstanding.erase(found);
+            cancelled.erase(textureID);
+        }
+    }
+
+    // fills job with the finished mip chain of an image file: from the texture cache when possible,
+    // otherwise decoded, filtered and (if compress is set) block compressed here, then stored in the cache.
+    static bool prepareTexture(const FileView &file, bool flipVertically, TextureUsage usage, bool mipmaps,
+                               bool compress, bool allowS3TC, DecodeQueue &queue, UploadJob &job)
+    {
+        uint64_t key = textureCacheKey(file, flipVertically, usage, mipmaps, compress, allowS3TC);
+        if (TextureCache::load(key, job.texture))
+        {
+            queue.cacheHits++;
+            return true;
+        }
+        job.texture = MipChain();
+        Image image;
+        if (!loadImageFromMemory(file, flipVertically, image))
+            return false;
+        GLenum format = chooseTextureFormat(image.pixels.get(), image.width, image.height, image.components, usage, compress, allowS3TC);
+        buildTexture(image.pixels.get(), image.width, image.height, image.components, usage, format, mipmaps, job.texture);
+        TextureCache::store(key, job.texture);
+        return true;
+    }
+
+    // 1x1 grey image, sampled until the real image is uploaded
+    static void setPlaceholder(GLenum target)
+    {
+        const unsigned char grey[4] = {128, 128, 128, 255};
+        glTexImage2D(target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    }
+
+    static GLenum bindingTarget(GLenum target)
+    {
+        return target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+    }
+
+    // copies bytes into the next pixel buffer of the ring and leaves it bound. Returns the pointer to pass to
+    // glTexSubImage2D, which is the buffer offset, or data itself if the buffer couldn't be mapped.
+    const void *stage(const unsigned char *data, size_t bytes)
+    {
+        if (pixelBuffers[0] == 0)
+            glGenBuffers(PIXEL_BUFFER_COUNT, pixelBuffers);
+        // orphan the buffer before writing, so the driver never has to wait for a previous copy out of it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[nextPixelBuffer]);
+        nextPixelBuffer = (nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes > PIXEL_BUFFER_SIZE ? bytes : PIXEL_BUFFER_SIZE, nullptr, GL_STREAM_DRAW);
+        void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!staging)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return data;
+        }
+        memcpy(staging, data, bytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return nullptr;
+    }
+
+    // copies the next slice of rows through a pixel buffer, returns true once the texture is complete.
+    // works through the mip chain from the smallest level up, every finished level becomes the texture's base level,
+    // so the texture is complete after the first (tiny) one and sharpens as the larger levels arrive.
+    bool uploadSlice(UploadJob &job)
+    {
+        MipChain &texture = job.texture;
+        GLenum binding = bindingTarget(job.target);
+        glBindTexture(binding, job.textureID);
+        if (!texture.valid())
+            return true; // failed to decode, keep the placeholder
+
+        int levels = (int)texture.levels.size();
+        if (job.level < 0)
+        {
+            job.level = levels - 1;
+            if (binding == GL_TEXTURE_2D)
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            // single channel textures are read as .xxx by the shaders, so give green and blue the same value
+            if (texture.format == GL_COMPRESSED_RED_RGTC1)
+            {
+                glTexParameteri(binding, GL_TEXTURE_SWIZZLE_G, GL_RED);
+                glTexParameteri(binding, GL_TEXTURE_SWIZZLE_B, GL_RED);
+            }
+        }
+
+        int level = job.level;
+        const vector<unsigned char> &data = texture.levels[level];
+        int width = max(1, texture.width >> level), height = max(1, texture.height >> level);
+        if (job.rowsUploaded == 0)
+        {
+            // allocating with a pixel buffer bound would read from it
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            if (texture.compressed())
+                glCompressedTexImage2D(job.target, level, texture.format, width, height, 0, (GLsizei)data.size(), nullptr);
+            else
+                glTexImage2D(job.target, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        // compressed slices are whole rows of 4x4 blocks
+        int blockHeight = texture.compressed() ? 4 : 1;
+        size_t blockRowBytes = levelBytes(texture.format, width, blockHeight);
+        int blockRows = blockRowBytes < PIXEL_BUFFER_SIZE ? (int)(PIXEL_BUFFER_SIZE / blockRowBytes) : 1;
+        int firstBlockRow = job.rowsUploaded / blockHeight;
+        blockRows = min(blockRows, (height + blockHeight - 1) / blockHeight - firstBlockRow);
+        int rows = min(blockRows * blockHeight, height - job.rowsUploaded);
+        size_t bytes = blockRowBytes * blockRows;
+        const void *pixels = stage(data.data() + blockRowBytes * firstBlockRow, bytes);
+        if (texture.compressed())
+            glCompressedTexSubImage2D(job.target, level, 0, job.rowsUploaded, width, rows, texture.format, (GLsizei)bytes, pixels);
+        else
+            glTexSubImage2D(job.target, level, 0, job.rowsUploaded, width, rows, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        job.rowsUploaded += rows;
+        if (job.rowsUploaded < height)
+            return false;
+
+        if (binding == GL_TEXTURE_2D)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        texture.levels[level] = vector<unsigned char>();
+        job.rowsUploaded = 0;
+        job.level--;
+        return job.level < 0;
+    }
+};
+#endif
@@ -0,0 +1,204 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/material.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/texture_registry.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// square layer sizes the textures are resized to, the smallest one that holds the image. larger images are scaled down
+const int TEXTURE_ARRAY_BUCKETS[] = {256, 512, 1024, 2048};
+
+// how a model's textures are packed into arrays, taken on the GL thread when the import starts since the
+// compressed formats depend on the context
+struct TextureArrayOptions {
+    bool enabled = false;
+    bool compress = true;
+    bool allowS3TC = false;
+};
+
+// A GL_TEXTURE_2D_ARRAY of a model's textures of one type, size and format, built on the import thread.
+// layer i is the texture at paths[i], a mesh samples it with textureLayers set to i for that type.
+struct TextureArrayData {
+    string type;            // texture_diffuse, texture_specular...
+    GLenum format = 0;
+    int size = 0;
+    uint64_t key = 0;       // of all the layers, so identical arrays are shared through the TextureRegistry
+    vector<string> paths;   // relative to the model's directory
+    vector<MipChain> layers;
+};
+
+int textureArrayBucket(int width, int height)
+{
+    int largest = max(width, height);
+    for (int size : TEXTURE_ARRAY_BUCKETS)
+        if (largest <= size)
+            return size;
+    return TEXTURE_ARRAY_BUCKETS[sizeof(TEXTURE_ARRAY_BUCKETS) / sizeof(TEXTURE_ARRAY_BUCKETS[0]) - 1];
+}
+
+// bilinear resample of an RGBA8 image to size x size, texel centers map onto texel centers
+vector<unsigned char> resizeImage(const vector<unsigned char> &rgba, int width, int height, int size)
+{
+    vector<unsigned char> resized((size_t)size * size * 4);
+    float scaleX = (float)width / size, scaleY = (float)height / size;
+    for (int y = 0; y < size; y++)
+    {
+        float sourceY = min(max((y + 0.5f) * scaleY - 0.5f, 0.0f), (float)(height - 1));
+        int y0 = (int)sourceY, y1 = min(y0 + 1, height - 1);
+        float fy = sourceY - y0;
+        for (int x = 0; x < size; x++)
+        {
+            float sourceX = min(max((x + 0.5f) * scaleX - 0.5f, 0.0f), (float)(width - 1));
+            int x0 = (int)sourceX, x1 = min(x0 + 1, width - 1);
+            float fx = sourceX - x0;
+            const unsigned char *t00 = &rgba[((size_t)y0 * width + x0) * 4], *t10 = &rgba[((size_t)y0 * width + x1) * 4];
+            const unsigned char *t01 = &rgba[((size_t)y1 * width + x0) * 4], *t11 = &rgba[((size_t)y1 * width + x1) * 4];
+            for (int c = 0; c < 4; c++)
+            {
+                float top = t00[c] + (t10[c] - t00[c]) * fx, bottom = t01[c] + (t11[c] - t01[c]) * fx;
+                resized[((size_t)y * size + x) * 4 + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return resized;
+}
+
+// the mip chain of one layer: the image file resized to its bucket, filtered and compressed like the TextureStreamer
+// would, or read back from the texture cache
+bool buildTextureArrayLayer(const FileView &file, TextureUsage usage, const TextureArrayOptions &options,
+                            MipChain &layer)
+{
+    int width, height, components;
+    if (!stbi_info_from_memory(file.data(), (int)file.size(), &width, &height, &components))
+        return false;
+    int size = textureArrayBucket(width, height);
+    uint64_t key = textureCacheKey(file, true, usage, true, options.compress, options.allowS3TC);
+    key = hashBytes(&size, sizeof(size), key);
+    if (TextureCache::load(key, layer) && layer.width == size && layer.height == size)
+        return true;
+
+    Image image;
+    if (!loadImageFromMemory(file, true, image))
+        return false;
+    vector<unsigned char> rgba = expandToRGBA(image.pixels.get(), image.width, image.height, image.components);
+    if (image.width != size || image.height != size)
+        rgba = resizeImage(rgba, image.width, image.height, size);
+    GLenum format = chooseTextureFormat(rgba.data(), size, size, 4, usage, options.compress, options.allowS3TC);
+    buildTexture(rgba.data(), size, size, 4, usage, format, true, layer);
+    TextureCache::store(key, layer);
+    return true;
+}
+
+// Packs the first texture of each type of every mesh into arrays, one per type, size and format, so meshes that only
+// differ in their textures share a material. textures that fail to decode are left out and loaded on their own.
+// runs on the import thread, sources holds the files Model::importModel already read
+void buildTextureArrays(const vector<MeshData> &meshes, const map<string, TextureSource> &sources,
+                        const TextureArrayOptions &options, vector<TextureArrayData> &arrays)
+{
+    set<pair<string, string>> packed;  // type, path
+    map<tuple<string, GLenum, int>, size_t> arrayIndices;
+    for (const MeshData &mesh : meshes)
+    {
+        bool typeSeen[MATERIAL_FIRST_ARRAY_TYPE] = {};
+        for (const Texture &texture : mesh.textures)
+        {
+            int type = materialTextureType(texture.type);
+            if (type == -1 || type >= (int)MATERIAL_FIRST_ARRAY_TYPE || typeSeen[type])
+                continue;
+            typeSeen[type] = true;
+            auto source = sources.find(texture.path);
+            if (source == sources.end() || !source->second.valid || !packed.insert(make_pair(texture.type, texture.path)).second)
+                continue;
+
+            MipChain layer;
+            if (!buildTextureArrayLayer(source->second.contents[0], textureUsageFromType(texture.type), options, layer)
+                || !layer.valid())
+                continue;
+            auto key = make_tuple(texture.type, layer.format, layer.width);
+            auto found = arrayIndices.find(key);
+            if (found == arrayIndices.end())
+            {
+                found = arrayIndices.emplace(key, arrays.size()).first;
+                arrays.emplace_back();
+                arrays.back().type = texture.type;
+                arrays.back().format = layer.format;
+                arrays.back().size = layer.width;
+            }
+            TextureArrayData &array = arrays[found->second];
+            array.key = hashBytes(&source->second.key, sizeof(uint64_t), array.key ^ ((uint64_t)array.format << 32 | (uint64_t)array.size));
+            array.paths.push_back(texture.path);
+            array.layers.push_back(move(layer));
+        }
+    }
+}
+
+size_t textureArrayBytes(const TextureArrayData &array)
+{
+    size_t bytes = 0;
+    for (const MipChain &layer : array.layers)
+        for (const vector<unsigned char> &level : layer.levels)
+            bytes += level.size();
+    return bytes;
+}
+
+// creates the array texture and uploads every level of every layer, on the GL thread. unlike single textures these
+// aren't streamed, the layers are already filtered and compressed so this is only the copy
+unsigned int uploadTextureArray(const TextureArrayData &array)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    int levels = (int)array.layers[0].levels.size();
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    // single channel textures are read as .xxx by the shaders, so give green and blue the same value
+    if (array.format == GL_COMPRESSED_RED_RGTC1)
+    {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GLsizei layerCount = (GLsizei)array.layers.size();
+    bool compressed = array.format != GL_RGBA8;
+    for (int level = 0; level < levels; level++)
+    {
+        int size = max(1, array.size >> level);
+        GLsizei bytes = (GLsizei)levelBytes(array.format, size, size);
+        if (compressed)
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.format, size, size, layerCount, 0, bytes * layerCount, nullptr);
+        else
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        for (GLsizei layer = 0; layer < layerCount; layer++)
+        {
+            const vector<unsigned char> &data = array.layers[layer].levels[level];
+            if (compressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size, size, 1, array.format, bytes, data.data());
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return textureID;
+}
+#endif
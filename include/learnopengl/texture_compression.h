@@ -0,0 +1,479 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/archive.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mipmap.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// S3TC isn't part of core OpenGL (RGTC is), so glad doesn't define its formats
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// bump whenever the encoders, the mip filter or the cache file layout change
+const uint32_t TEXTURE_CACHE_VERSION = 2;
+const char * const TEXTURE_CACHE_DIRECTORY = "resources/cache/textures";
+const char TEXTURE_CACHE_MAGIC[8] = "LOGLTEX";
+
+// what a texture is sampled for, decides which block compression format it's stored in
+enum TextureUsage {
+    TEXTURE_USAGE_COLOR,     // BC1, or BC3 when the image has non opaque alpha
+    TEXTURE_USAGE_SPECULAR,  // BC4, a single channel that shaders read as .xxx
+    TEXTURE_USAGE_NORMAL     // BC5, x and y only; shaders that sample it have to reconstruct z
+};
+
+TextureUsage textureUsageFromType(const string &type)
+{
+    if (type == "texture_specular")
+        return TEXTURE_USAGE_SPECULAR;
+    if (type == "texture_normal")
+        return TEXTURE_USAGE_NORMAL;
+    return TEXTURE_USAGE_COLOR;
+}
+
+// true when the context can sample BC1/BC3, checked once on the GL thread
+bool hasS3TCSupport()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        supported = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name && (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0))
+                supported = 1;
+        }
+    }
+    return supported == 1;
+}
+
+// mip chain ready for upload, either block compressed or plain GL_RGBA8.
+// level i is max(1, width >> i) x max(1, height >> i)
+struct MipChain {
+    GLenum format = 0;
+    int width = 0;
+    int height = 0;
+    vector<vector<unsigned char>> levels;
+
+    bool valid() const
+    {
+        return format != 0 && !levels.empty();
+    }
+
+    bool compressed() const
+    {
+        return format != GL_RGBA8;
+    }
+};
+
+int blockBytes(GLenum format)
+{
+    return (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+}
+
+size_t levelBytes(GLenum format, int width, int height)
+{
+    if (format == GL_RGBA8)
+        return (size_t)width * height * 4;
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+// estimated video memory of a texture once it's compressed
+size_t compressedTextureBytes(int width, int height, int components, TextureUsage usage, bool mipmaps)
+{
+    size_t bytes = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+    if (usage == TEXTURE_USAGE_NORMAL || (usage == TEXTURE_USAGE_COLOR && (components == 2 || components == 4)))
+        bytes *= 16;
+    else
+        bytes *= 8;
+    return mipmaps ? bytes * 4 / 3 : bytes;
+}
+
+// Block encoders. Each takes a 4x4 block of RGBA8 texels (row major) and writes one compressed block.
+// ------------------------------------------------------------------------------------------------
+
+unsigned short packRGB565(const float color[3])
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    r = min(max(r, 0), 31);
+    g = min(max(g, 0), 63);
+    b = min(max(b, 0), 31);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(unsigned short packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block in four color mode. Endpoints are the extremes of the block along its principal axis.
+void encodeBC1Block(const unsigned char *rgba, unsigned char *out)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[i * 4 + c] / 16.0f;
+
+    float covariance[6] = {0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+        covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+        covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+    }
+    // a few power iterations are enough to find the dominant axis of 16 colors
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+        float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+        float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+        float length = max(fabs(x), max(fabs(y), fabs(z)));
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+    }
+
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = (rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] + (rgba[i * 4 + 2] - mean[2]) * axis[2];
+        minProjection = min(minProjection, projection);
+        maxProjection = max(maxProjection, projection);
+    }
+    float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float endpoints[2][3];
+    for (int c = 0; c < 3; c++)
+    {
+        endpoints[0][c] = mean[c] + axis[c] * maxProjection / max(axisLength, 1e-6f);
+        endpoints[1][c] = mean[c] + axis[c] * minProjection / max(axisLength, 1e-6f);
+    }
+
+    unsigned short color0 = packRGB565(endpoints[0]);
+    unsigned short color1 = packRGB565(endpoints[1]);
+    if (color0 < color1)
+        swap(color0, color1);
+
+    unsigned int indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackRGB565(color0, palette[0]);
+        unpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (unsigned int)best << (i * 2);
+        }
+    }
+    out[0] = color0 & 0xFF; out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF; out[3] = color1 >> 8;
+    out[4] = indices & 0xFF; out[5] = (indices >> 8) & 0xFF; out[6] = (indices >> 16) & 0xFF; out[7] = indices >> 24;
+}
+
+// BC4 block (eight value mode) for the given channel of the block
+void encodeBC4Block(const unsigned char *rgba, int channel, unsigned char *out)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = min(low, (int)rgba[i * 4 + channel]);
+        high = max(high, (int)rgba[i * 4 + channel]);
+    }
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        int palette[8] = {high, low};
+        for (int p = 1; p < 7; p++)
+            palette[p + 1] = ((7 - p) * high + p * low) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int value = rgba[i * 4 + channel];
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = abs(value - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = (unsigned char)(indices >> (b * 8));
+}
+
+void encodeBlock(const unsigned char *rgba, GLenum format, unsigned char *out)
+{
+    switch (format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            encodeBC1Block(rgba, out);
+            break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            encodeBC4Block(rgba, 3, out);
+            encodeBC1Block(rgba, out + 8);
+            break;
+        case GL_COMPRESSED_RED_RGTC1:
+            encodeBC4Block(rgba, 0, out);
+            break;
+        case GL_COMPRESSED_RG_RGTC2:
+            encodeBC4Block(rgba, 0, out);
+            encodeBC4Block(rgba, 1, out + 8);
+            break;
+    }
+}
+
+// compresses one RGBA8 level, blocks on the right and bottom edge repeat the last texel
+void compressLevel(const unsigned char *rgba, int width, int height, GLenum format, vector<unsigned char> &out)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    int bytes = blockBytes(format);
+    out.resize((size_t)blocksX * blocksY * bytes);
+    unsigned char block[64];
+    for (int by = 0; by < blocksY; by++)
+    {
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int y = 0; y < 4; y++)
+            {
+                int sy = min(by * 4 + y, height - 1);
+                for (int x = 0; x < 4; x++)
+                {
+                    int sx = min(bx * 4 + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+            encodeBlock(block, format, out.data() + ((size_t)by * blocksX + bx) * bytes);
+        }
+    }
+}
+
+// widens 8 bit pixels to RGBA8, the missing channels are filled the way OpenGL fills them for GL_RED/GL_RG/GL_RGB
+vector<unsigned char> expandToRGBA(const unsigned char *pixels, int width, int height, int components)
+{
+    size_t texels = (size_t)width * height;
+    vector<unsigned char> rgba(texels * 4);
+    for (size_t i = 0; i < texels; i++)
+    {
+        unsigned char texel[4] = {0, 0, 0, 255};
+        for (int c = 0; c < components; c++)
+            texel[c] = pixels[i * components + c];
+        memcpy(&rgba[i * 4], texel, 4);
+    }
+    return rgba;
+}
+
+bool hasTranslucentTexels(const unsigned char *pixels, int width, int height, int components)
+{
+    if (components != 2 && components != 4)
+        return false;
+    size_t texels = (size_t)width * height;
+    for (size_t i = 0; i < texels; i++)
+        if (pixels[i * components + components - 1] != 255)
+            return true;
+    return false;
+}
+
+// picks the format an image is stored in. Without compress, or for color textures when the context can't
+// sample BC1/BC3 (allowS3TC), that's plain GL_RGBA8.
+GLenum chooseTextureFormat(const unsigned char *pixels, int width, int height, int components, TextureUsage usage,
+                           bool compress, bool allowS3TC)
+{
+    if (!compress)
+        return GL_RGBA8;
+    if (usage == TEXTURE_USAGE_SPECULAR)
+        return GL_COMPRESSED_RED_RGTC1;
+    if (usage == TEXTURE_USAGE_NORMAL)
+        return GL_COMPRESSED_RG_RGTC2;
+    if (!allowS3TC)
+        return GL_RGBA8;
+    return hasTranslucentTexels(pixels, width, height, components) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                                                   : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+// builds the texture of 8 bit pixels in the given format, with its whole mip chain if mipmaps is set (see buildMipChain).
+// color is filtered in linear space, and translucent color textures keep their alpha test coverage.
+void buildTexture(const unsigned char *pixels, int width, int height, int components, TextureUsage usage, GLenum format,
+                  bool mipmaps, MipChain &texture)
+{
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.levels.clear();
+
+    vector<unsigned char> image = expandToRGBA(pixels, width, height, components);
+    vector<vector<unsigned char>> levels;
+    if (mipmaps)
+    {
+        MipFilter filter;
+        bool translucent = usage == TEXTURE_USAGE_COLOR && hasTranslucentTexels(pixels, width, height, components);
+        filter.gammaCorrect = usage == TEXTURE_USAGE_COLOR;
+        filter.premultiplyAlpha = translucent;
+        filter.alphaCutoff = translucent ? ALPHA_TEST_CUTOFF : 0.0f;
+        buildMipChain(filter, move(image), width, height, levels);
+    }
+    else
+        levels.push_back(move(image));
+
+    if (format == GL_RGBA8)
+    {
+        texture.levels.swap(levels);
+        return;
+    }
+    texture.levels.resize(levels.size());
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        compressLevel(levels[i].data(), max(1, width >> i), max(1, height >> i), format, texture.levels[i]);
+        levels[i] = vector<unsigned char>();
+    }
+}
+
+// key of the cache entry for an image file: its contents plus everything that changes the encoded result
+uint64_t textureCacheKey(const FileView &contents, bool flipVertically, TextureUsage usage, bool mipmaps,
+                         bool compress, bool allowS3TC)
+{
+    uint64_t parameters = (uint64_t)TEXTURE_CACHE_VERSION << 8 | (uint64_t)usage << 4 | (compress ? 8 : 0)
+                        | (mipmaps ? 4 : 0) | (allowS3TC ? 2 : 0) | (flipVertically ? 1 : 0);
+    return hashBytes(contents.data(), contents.size(), parameters);
+}
+
+// On disk cache of finished mip chains, one file per source image named after its textureCacheKey,
+// so a changed file simply gets a new entry. Layout:
+//
+//   TextureCacheHeader
+//   per level: uint32_t byte count, block data
+class TextureCache
+{
+public:
+    static bool load(uint64_t key, MipChain &texture)
+    {
+        ifstream in(getCachePath(key), ios::binary);
+        if (!in)
+            return false;
+        TextureCacheHeader header;
+        if (!in.read((char *)&header, sizeof(header)) || memcmp(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic)) != 0
+            || header.version != TEXTURE_CACHE_VERSION || header.key != key || header.levels == 0 || header.levels > 32)
+            return false;
+
+        texture.format = header.format;
+        texture.width = (int)header.width;
+        texture.height = (int)header.height;
+        texture.levels.assign(header.levels, vector<unsigned char>());
+        for (uint32_t i = 0; i < header.levels; i++)
+        {
+            uint32_t size;
+            if (!in.read((char *)&size, sizeof(size)))
+                return false;
+            int levelWidth = max(1, texture.width >> i), levelHeight = max(1, texture.height >> i);
+            if (size != levelBytes(texture.format, levelWidth, levelHeight))
+                return false;
+            texture.levels[i].resize(size);
+            if (!in.read((char *)texture.levels[i].data(), size))
+                return false;
+        }
+        return true;
+    }
+
+    // called from worker threads, every texture has its own file so writers never collide
+    static bool store(uint64_t key, const MipChain &texture)
+    {
+        mkdir("resources/cache", 0755);
+        mkdir(TEXTURE_CACHE_DIRECTORY, 0755);
+
+        TextureCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+        header.version = TEXTURE_CACHE_VERSION;
+        header.format = texture.format;
+        header.width = (uint32_t)texture.width;
+        header.height = (uint32_t)texture.height;
+        header.levels = (uint32_t)texture.levels.size();
+        header.key = key;
+
+        string path = getCachePath(key);
+        string tmpPath = path + ".tmp";
+        {
+            ofstream out(tmpPath, ios::binary);
+            out.write((const char *)&header, sizeof(header));
+            for (const vector<unsigned char> &level : texture.levels)
+            {
+                uint32_t size = (uint32_t)level.size();
+                out.write((const char *)&size, sizeof(size));
+                out.write((const char *)level.data(), size);
+            }
+            if (!out)
+            {
+                remove(tmpPath.c_str());
+                return false;
+            }
+        }
+        return rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    struct TextureCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        uint32_t reserved;
+        uint64_t key;
+    };
+
+    static string getCachePath(uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)key);
+        return string(TEXTURE_CACHE_DIRECTORY) + '/' + name;
+    }
+};
+#endif
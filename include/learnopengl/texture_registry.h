@@ -0,0 +1,212 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_compression.h>
+#include <learnopengl/vfs.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+// what a texture will be made of: a hash of the encoded file contents (and of everything else that changes the result,
+// like flipping), the estimated size of the uploaded texture and the file itself, so it doesn't have to be opened twice.
+struct TextureSource {
+    uint64_t key = 0;
+    size_t bytes = 0;
+    bool valid = false;
+    vector<FileView> contents;
+};
+
+enum TextureKind {
+    TEXTURE_KIND_2D = 1,
+    TEXTURE_KIND_CUBEMAP = 2
+};
+
+// opens an image file through the VirtualFileSystem and describes it. Doesn't touch OpenGL, so it can run on worker threads.
+// for cubemaps, call it once per face with the same source. usage is part of the key, since it decides the compressed format.
+bool describeTextureFile(const string &path, bool flipVertically, TextureKind kind, TextureSource &source,
+                         TextureUsage usage = TEXTURE_USAGE_COLOR)
+{
+    FileView contents = VirtualFileSystem::shared().open(path);
+    if (!contents.valid())
+        return false;
+
+    int width, height, components;
+    if (!stbi_info_from_memory(contents.data(), (int)contents.size(), &width, &height, &components))
+        return false;
+    // textures are block compressed by the TextureStreamer, mip chains add a third
+    size_t bytes = compressedTextureBytes(width, height, components, usage, kind == TEXTURE_KIND_2D);
+
+    uint64_t parameters = (uint64_t)usage << 3 | (uint64_t)kind << 1 | (flipVertically ? 1 : 0);
+    source.key = hashBytes(contents.data(), contents.size(), source.key ^ parameters);
+    source.bytes += bytes;
+    source.valid = true;
+    source.contents.push_back(contents);
+    return true;
+}
+
+// Process wide registry of loaded textures, keyed by content, so an image that is used by several models
+// (or loaded again through loadTexture) is only uploaded once. Textures are reference counted:
+// every acquire has to be matched by a release, and textures nobody references are deleted by collectGarbage.
+class TextureRegistry
+{
+public:
+    static TextureRegistry &shared()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // returns the texture registered for source, or creates it with create and registers it.
+    // textures from invalid sources (missing files...) are created but not shared, release still deletes them.
+    unsigned int acquire(const TextureSource &source, const function<unsigned int()> &create)
+    {
+        if (!source.valid)
+        {
+            unsigned int textureID = create();
+            unshared.insert(textureID);
+            return textureID;
+        }
+
+        auto found = entries.find(source.key);
+        if (found != entries.end())
+        {
+            Entry &entry = found->second;
+            entry.references++;
+            entry.acquisitions++;
+            hits++;
+            return entry.textureID;
+        }
+
+        Entry entry;
+        entry.textureID = create();
+        entry.bytes = source.bytes;
+        keys[entry.textureID] = source.key;
+        entries[source.key] = entry;
+        return entry.textureID;
+    }
+
+    void release(unsigned int textureID)
+    {
+        if (unshared.erase(textureID))
+        {
+            garbage.push_back(textureID);
+            return;
+        }
+        auto key = keys.find(textureID);
+        if (key == keys.end())
+            return;
+        Entry &entry = entries[key->second];
+        if (--entry.references == 0)
+        {
+            garbage.push_back(textureID);
+            entries.erase(key->second);
+            keys.erase(key);
+        }
+    }
+
+    // deletes textures that are no longer referenced, must be called on the GL thread. textures the streamer is still
+    // loading have their jobs cancelled and stay in the garbage until it has dropped them
+    void collectGarbage()
+    {
+        if (garbage.empty())
+            return;
+        TextureStreamer &streamer = TextureStreamer::shared();
+        deletable.clear();
+        size_t kept = 0;
+        for (unsigned int textureID : garbage)
+        {
+            if (streamer.streaming(textureID))
+            {
+                streamer.cancel(textureID);
+                garbage[kept++] = textureID;
+            }
+            else
+                deletable.push_back(textureID);
+        }
+        garbage.resize(kept);
+        if (!deletable.empty())
+            glDeleteTextures((GLsizei)deletable.size(), deletable.data());
+    }
+
+    // loads a 2D texture through the TextureStreamer, unless one with the same contents is already registered.
+    // reads the file on the calling thread to hash it.
+    unsigned int load(const string &path, bool flipVertically, TextureUsage usage = TEXTURE_USAGE_COLOR)
+    {
+        TextureSource source;
+        describeTextureFile(path, flipVertically, TEXTURE_KIND_2D, source, usage);
+        return acquire(source, [&] {
+            return TextureStreamer::shared().load(path, flipVertically, source.valid ? source.contents[0] : FileView(), usage);
+        });
+    }
+
+    unsigned int loadCubemap(const vector<string> &faces, bool flipVertically)
+    {
+        TextureSource source;
+        bool complete = true;
+        for (const string &face : faces)
+            complete = describeTextureFile(face, flipVertically, TEXTURE_KIND_CUBEMAP, source) && complete;
+        if (!complete)
+        {
+            source.valid = false;
+            source.contents.clear();
+        }
+        return acquire(source, [&] {
+            return TextureStreamer::shared().loadCubemap(faces, flipVertically, source.contents);
+        });
+    }
+
+    // number of distinct textures currently registered
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    // number of acquires that reused an existing texture instead of uploading a duplicate
+    unsigned int reuseCount() const
+    {
+        return hits;
+    }
+
+    size_t residentBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &entry : entries)
+            bytes += entry.second.bytes;
+        return bytes;
+    }
+
+    // estimated video memory the duplicate loads would have taken
+    size_t savedBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &entry : entries)
+            bytes += entry.second.bytes * (entry.second.acquisitions - 1);
+        return bytes;
+    }
+
+private:
+    struct Entry {
+        unsigned int textureID = 0;
+        unsigned int references = 1;
+        unsigned int acquisitions = 1;
+        size_t bytes = 0;
+    };
+
+    unordered_map<uint64_t, Entry> entries;
+    unordered_map<unsigned int, uint64_t> keys;  // texture id -> content key
+    unordered_set<unsigned int> unshared;        // textures of invalid sources, one reference each
+    vector<unsigned int> garbage, deletable;
+    unsigned int hits = 0;
+};
+#endif
@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Fixed size pool of worker threads for CPU side loading work (asset import, image decoding...).
+// jobs must not touch OpenGL, results that need the context are handed back to the main thread by the caller.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount())
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+            jobs.clear(); // jobs that haven't started yet are dropped, running ones are waited for
+        }
+        jobAvailable.notify_all();
+        for (thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void enqueue(function<void()> job)
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            jobs.push_back(move(job));
+        }
+        jobAvailable.notify_one();
+    }
+
+    unsigned int size() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    // pool shared by all loaders, created on first use
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // one thread per core, minus the one that owns the GL context
+    static unsigned int defaultThreadCount()
+    {
+        unsigned int cores = thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+private:
+    vector<thread> workers;
+    deque<function<void()>> jobs;
+    mutex queueMutex;
+    condition_variable jobAvailable;
+    bool stopping = false;
+
+    void run()
+    {
+        while (true)
+        {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+#endif
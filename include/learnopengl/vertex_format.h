@@ -0,0 +1,158 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+// how a mesh stores its vertices on the GPU
+enum VertexFormat {
+    VERTEX_FORMAT_FULL,    // Vertex as is, 56 bytes
+    VERTEX_FORMAT_PACKED   // PackedVertex, 16 bytes, decoded by the vertex shader
+};
+
+// where a vertex attribute comes from in a CPU side vertex struct (offset and size in bytes), and how the shader reads it
+struct VertexAttribute {
+    unsigned int location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+    size_t size;
+};
+
+// Compact vertex, the shader gets positionScale/positionOffset uniforms to decode it (see Mesh::Draw).
+//   position:     unsigned normalized 16 bit, relative to the mesh's bounding box (w is padding)
+//   tangentFrame: tangent space as a quaternion, signed normalized 8 bit, w < 0 when the bitangent is mirrored.
+//                 the normal is the third column of its rotation, so it isn't stored separately
+//   texCoords:    half floats
+struct PackedVertex {
+    uint16_t Position[4];
+    int8_t   TangentFrame[4];
+    uint16_t TexCoords[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex size");
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0)); // inf or nan
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7C00); // too large, becomes inf
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return (uint16_t)sign; // too small, becomes zero
+        // subnormal half
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = sign | (uint32_t)exponent << 10 | mantissa >> 13;
+    if (mantissa & 0x1000)
+        half++; // round, a carry into the exponent is still correct
+    return (uint16_t)half;
+}
+
+int8_t packSnorm8(float value)
+{
+    return (int8_t)lround(min(max(value, -1.0f), 1.0f) * 127.0f);
+}
+
+// encodes the tangent space of a vertex as a rotation quaternion, mirrored uv mapping is kept in the sign of w
+void encodeTangentFrame(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent, int8_t out[4])
+{
+    normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    // orthogonalize the tangent, meshes without texture coordinates don't have one so pick any perpendicular vector
+    tangent = tangent - normal * glm::dot(normal, tangent);
+    if (glm::length(tangent) < 1e-6f)
+        tangent = fabs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+    tangent = glm::normalize(tangent);
+    glm::vec3 orthogonalBitangent = glm::cross(normal, tangent);
+    bool mirrored = glm::dot(orthogonalBitangent, bitangent) < 0.0f;
+
+    // rotation matrix with columns tangent, bitangent, normal to quaternion
+    float m00 = tangent.x, m01 = orthogonalBitangent.x, m02 = normal.x;
+    float m10 = tangent.y, m11 = orthogonalBitangent.y, m12 = normal.y;
+    float m20 = tangent.z, m21 = orthogonalBitangent.z, m22 = normal.z;
+    float q[4]; // x, y, z, w
+    float trace = m00 + m11 + m22;
+    if (trace > 0.0f)
+    {
+        float s = sqrt(trace + 1.0f) * 2.0f;
+        q[3] = 0.25f * s; q[0] = (m21 - m12) / s; q[1] = (m02 - m20) / s; q[2] = (m10 - m01) / s;
+    }
+    else if (m00 > m11 && m00 > m22)
+    {
+        float s = sqrt(1.0f + m00 - m11 - m22) * 2.0f;
+        q[3] = (m21 - m12) / s; q[0] = 0.25f * s; q[1] = (m01 + m10) / s; q[2] = (m02 + m20) / s;
+    }
+    else if (m11 > m22)
+    {
+        float s = sqrt(1.0f + m11 - m00 - m22) * 2.0f;
+        q[3] = (m02 - m20) / s; q[0] = (m01 + m10) / s; q[1] = 0.25f * s; q[2] = (m12 + m21) / s;
+    }
+    else
+    {
+        float s = sqrt(1.0f + m22 - m00 - m11) * 2.0f;
+        q[3] = (m10 - m01) / s; q[0] = (m02 + m20) / s; q[1] = (m12 + m21) / s; q[2] = 0.25f * s;
+    }
+
+    // q and -q are the same rotation, so w can be made positive and its sign used for the mirroring.
+    // w is kept away from zero, where 8 bits couldn't tell +0 from -0
+    float sign = q[3] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0; i < 4; i++)
+        q[i] *= sign;
+    const float minW = 1.0f / 127.0f;
+    if (q[3] < minW)
+    {
+        float scale = sqrt(1.0f - minW * minW) / max(sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]), 1e-6f);
+        q[0] *= scale; q[1] *= scale; q[2] *= scale;
+        q[3] = minW;
+    }
+    if (mirrored)
+        for (int i = 0; i < 4; i++)
+            q[i] = -q[i];
+    for (int i = 0; i < 4; i++)
+        out[i] = packSnorm8(q[i]);
+}
+
+// range of the quantized positions: position = packed * scale + offset, packed in [0, 1]
+void packedPositionRange(const glm::vec3 &min, const glm::vec3 &max, glm::vec3 &scale, glm::vec3 &offset)
+{
+    offset = min;
+    scale = max - min;
+}
+
+// packs a vertex, scale and offset come from packedPositionRange
+PackedVertex packVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                        const glm::vec3 &tangent, const glm::vec3 &bitangent, const glm::vec3 &scale, const glm::vec3 &offset)
+{
+    PackedVertex packed;
+    for (int i = 0; i < 3; i++)
+    {
+        float t = scale[i] > 0.0f ? (position[i] - offset[i]) / scale[i] : 0.0f;
+        packed.Position[i] = (uint16_t)lround(min(max(t, 0.0f), 1.0f) * 65535.0f);
+    }
+    packed.Position[3] = 0;
+    encodeTangentFrame(normal, tangent, bitangent, packed.TangentFrame);
+    packed.TexCoords[0] = floatToHalf(texCoords.x);
+    packed.TexCoords[1] = floatToHalf(texCoords.y);
+    return packed;
+}
+#endif
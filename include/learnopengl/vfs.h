@@ -0,0 +1,99 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <learnopengl/archive.h>
+#include <learnopengl/filesystem.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Where the loaders read files from. paths are looked up in the mounted archives first, most recently mounted first,
+// then on disk, so a packed build and loose files in the tree (and files the archive doesn't have) just work.
+// either way the file comes back as a view of a mapping (see FileView), without being copied into a stream first
+class VirtualFileSystem
+{
+public:
+    static VirtualFileSystem &shared()
+    {
+        static VirtualFileSystem vfs;
+        return vfs;
+    }
+
+    // mounts an archive written by pack_assets. not thread safe: mount before any loader starts, lookups afterwards
+    // are safe from any thread
+    bool mount(const string &archivePath)
+    {
+        unique_ptr<Archive> archive(new Archive());
+        if (!archive->open(archivePath))
+            return false;
+        archives.insert(archives.begin(), move(archive));
+        return true;
+    }
+
+    size_t mounted() const
+    {
+        return archives.size();
+    }
+
+    // the whole file at path, an invalid view if neither an archive nor the disk has it
+    FileView open(const string &path) const
+    {
+        if (!archives.empty())
+        {
+            string name = normalize(path);
+            for (const unique_ptr<Archive> &archive : archives)
+                if (const ArchiveEntry *entry = archive->find(name))
+                    return archive->view(*entry);
+        }
+        return mapFile(path);
+    }
+
+    bool exists(const string &path) const
+    {
+        uint64_t size, stamp;
+        return describe(path, size, stamp);
+    }
+
+    // size of the file and a stamp that changes when its contents do, without reading it: the content hash of archive
+    // entries, the modification time of loose files. for cache keys, false if the file doesn't exist
+    bool describe(const string &path, uint64_t &size, uint64_t &stamp) const
+    {
+        if (!archives.empty())
+        {
+            string name = normalize(path);
+            for (const unique_ptr<Archive> &archive : archives)
+                if (const ArchiveEntry *entry = archive->find(name))
+                {
+                    size = entry->size;
+                    stamp = entry->hash;
+                    return true;
+                }
+        }
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            return false;
+        size = (uint64_t)st.st_size;
+        stamp = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    // the path a file is packed under: relative to the project root, so the FileSystem::getPath prefix goes
+    // (see normalizeArchivePath for the rest)
+    static string normalize(const string &path)
+    {
+        static const string root = FileSystem::getPath("");
+        if (!root.empty() && path.compare(0, root.size(), root) == 0)
+            return normalizeArchivePath(path.substr(root.size()));
+        return normalizeArchivePath(path);
+    }
+
+private:
+    vector<unique_ptr<Archive>> archives;
+};
+#endif
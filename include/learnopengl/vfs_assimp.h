@@ -0,0 +1,92 @@
+#ifndef VFS_ASSIMP_H
+#define VFS_ASSIMP_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/vfs.h>
+
+#include <cstring>
+#include <string>
+using namespace std;
+
+// An assimp file read out of a FileView, so models and the files they reference (.bin buffers, .mtl libraries)
+// come out of the VirtualFileSystem like everything else. read only
+class VfsIOStream : public Assimp::IOStream
+{
+public:
+    explicit VfsIOStream(FileView file) : file(move(file))
+    {
+    }
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        count = min(count, (file.size() - position) / size);
+        memcpy(buffer, file.data() + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void *, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? position : file.size();
+        if (offset > file.size() - base)
+            return aiReturn_FAILURE;
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return position;
+    }
+
+    size_t FileSize() const override
+    {
+        return file.size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    FileView file;
+    size_t position = 0;
+};
+
+// hands assimp files from the VirtualFileSystem, set it on an importer with SetIOHandler (which takes ownership)
+class VfsIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *path) const override
+    {
+        return VirtualFileSystem::shared().exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+            return nullptr;
+        FileView file = VirtualFileSystem::shared().open(path);
+        return file.valid() ? new VfsIOStream(file) : nullptr;
+    }
+
+    void Close(Assimp::IOStream *stream) override
+    {
+        delete stream;
+    }
+};
+#endif
@@ -2,43 +2,40 @@
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "frame.glsl"
 
 struct Material {
     sampler2D texture_diffuse1;
     sampler2D texture_specular1;
+    // models with SetTextureArrays share these between their meshes, TextureLayers picks the layer
+    sampler2DArray texture_diffuse_array1;
+    sampler2DArray texture_specular_array1;
 
     float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+// per draw values, from uniforms or on the multi draw path from the draw data (see the vertex shaders)
+flat in vec4 TextureLayers;
+flat in vec4 ObjectParameters;
 
-uniform vec3 viewPos;
-
-uniform PointLight pointLight;
-uniform DirLight dirLight;
 uniform Material material;
 
-uniform vec3 viewPosition;
+vec4 diffuseTexel()
+{
+    if (TextureLayers.x >= 0.0)
+        return texture(material.texture_diffuse_array1, vec3(TexCoords, TextureLayers.x));
+    return texture(material.texture_diffuse1, TexCoords);
+}
+
+vec4 specularTexel()
+{
+    if (TextureLayers.y >= 0.0)
+        return texture(material.texture_specular_array1, vec3(TexCoords, TextureLayers.y));
+    return texture(material.texture_specular1, TexCoords);
+}
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -52,9 +49,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.1 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
+    vec3 ambient = light.ambient * vec3(diffuseTexel());
+    vec3 diffuse = light.diffuse * diff * vec3(diffuseTexel());
+    vec3 specular = light.specular * spec * vec3(specularTexel().xxx);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -69,9 +66,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient  = light.ambient  * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse  = light.diffuse  * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords));
+    vec3 ambient  = light.ambient  * vec3(diffuseTexel());
+    vec3 diffuse  = light.diffuse  * diff * vec3(diffuseTexel());
+    vec3 specular = light.specular * spec * vec3(specularTexel());
     return (ambient + diffuse + specular);
 }
 
@@ -79,9 +76,11 @@ void main()
 {
     // properties
     vec3 norm = normalize(Normal);
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPosition - FragPos);
 
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+    DirLight light = dirLight;
+    light.direction *= ObjectParameters.x;
+    vec3 result = CalcDirLight(light, norm, viewDir);
       result += CalcPointLight(pointLight, norm, FragPos, viewDir);
 
         float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
@@ -1,20 +1,51 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+// the normal, or the tangent frame quaternion of packed vertices
+layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out vec4 TextureLayers;
+flat out vec4 ObjectParameters;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// layer of the diffuse and specular texture in the material's texture arrays, negative when the mesh uses texture_diffuse1...
+uniform vec4 textureLayers;
+// per object values from the render queue, x is 1 or -1: the models from the old tree on are lit from the opposite direction
+uniform vec4 objectParameters;
+
+#include "frame.glsl"
+
+// packed vertices (see vertex_format.h): positions are quantized to the mesh bounds, normals come from the tangent frame
+uniform bool packedVertices;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// tangent, bitangent and normal from the tangent frame quaternion, w < 0 when the bitangent is mirrored
+mat3 decodeTangentFrame(vec4 q)
+{
+    q = normalize(q);
+    vec3 t = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    vec3 b = vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+    vec3 n = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    return mat3(t, q.w < 0.0 ? -b : b, n);
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    vec3 position = aPos;
+    vec3 normal = aNormal.xyz;
+    if (packedVertices)
+    {
+        position = aPos * positionScale + positionOffset;
+        normal = decodeTangentFrame(aNormal)[2];
+    }
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = normal;
     TexCoords = aTexCoords;    
+    TextureLayers = textureLayers;
+    ObjectParameters = objectParameters;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
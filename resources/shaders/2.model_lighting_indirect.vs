@@ -0,0 +1,56 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+// the normal, or the tangent frame quaternion of packed vertices
+layout (location = 1) in vec4 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// index of the draw, from the base instance of its indirect command (see GeometryPool::setDrawIdBuffer)
+layout (location = 5) in uint aDrawID;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out vec4 TextureLayers;
+flat out vec4 ObjectParameters;
+
+#include "frame.glsl"
+
+// what 2.model_lighting.vs gets as uniforms, one record per draw (see IndirectDrawData in render_queue.h)
+struct DrawData {
+    mat4 model;
+    vec4 textureLayers;
+    vec4 positionScale;   // w is 1 for packed vertices
+    vec4 positionOffset;
+    vec4 parameters;
+};
+
+layout (std430, binding = 1) readonly buffer Draws {
+    DrawData draws[];
+};
+
+// tangent, bitangent and normal from the tangent frame quaternion, w < 0 when the bitangent is mirrored
+mat3 decodeTangentFrame(vec4 q)
+{
+    q = normalize(q);
+    vec3 t = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    vec3 b = vec3(2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x));
+    vec3 n = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    return mat3(t, q.w < 0.0 ? -b : b, n);
+}
+
+void main()
+{
+    DrawData draw = draws[aDrawID];
+    vec3 position = aPos;
+    vec3 normal = aNormal.xyz;
+    if (draw.positionScale.w != 0.0)
+    {
+        position = aPos * draw.positionScale.xyz + draw.positionOffset.xyz;
+        normal = decodeTangentFrame(aNormal)[2];
+    }
+    FragPos = vec3(draw.model * vec4(position, 1.0));
+    Normal = normal;
+    TexCoords = aTexCoords;
+    TextureLayers = draw.textureLayers;
+    ObjectParameters = draw.parameters;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -6,19 +6,11 @@ in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
+#include "frame.glsl"
 
 
 uniform sampler2D texture1;
 uniform float shininess;
-uniform DirLight dirLight;
-uniform vec3 viewPosition;
 
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 2) in vec3 aNormal;
+// transform of the instance, a column per location 6 to 9 (see InstanceBuffer in instancing.h)
+layout (location = 6) in mat4 aInstanceModel;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+uniform mat4 model;
+
+#include "frame.glsl"
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Normal = aNormal;
+    FragPos = vec3(model * aInstanceModel * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
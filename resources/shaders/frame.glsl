@@ -0,0 +1,29 @@
+// camera and lights, written once per frame for every program. the one copy of the block, shaders pull it in with
+// #include "frame.glsl" (see Shader::resolveIncludes); keep it in step with FrameUniforms in frame_uniforms.h
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+    DirLight dirLight;
+    PointLight pointLight;
+};
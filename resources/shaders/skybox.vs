@@ -3,12 +3,12 @@ layout (location = 0) in vec3 aPos;
 
 out vec3 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+#include "frame.glsl"
 
 void main()
 {
     TexCoords = vec3(aPos.x, -aPos.y, aPos.z); // Rotacija za 180 stepeni zbog skyboxa
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // the sky moves with the camera, only the rotation of the view applies
+    vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
     gl_Position = pos.xyww;
 }
\ No newline at end of file
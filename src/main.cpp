@@ -10,11 +10,25 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
+#include <learnopengl/frame_uniforms.h>
+#include <learnopengl/gl_features.h>
+#include <learnopengl/instancing.h>
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/model_loader.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/scene_bvh.h>
+#include <learnopengl/scene_graph.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_registry.h>
+#include <learnopengl/vfs.h>
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <random>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -22,17 +36,21 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
 void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 unsigned int loadCubemap(vector<std::string> faces);
 
-unsigned int loadTexture(char const *path);
+unsigned int loadTexture(char const *path, bool flipVertically = true);
 
 // settings
 const unsigned int SCR_WIDTH = 1920;
 const unsigned int SCR_HEIGHT = 1080;
+// tumbleweeds scattered over the ground, drawn instanced
+const int MAX_TUMBLEWEEDS = 10000;
 
 // camera
 
@@ -71,6 +89,19 @@ struct ProgramState {
     float backpackScale = 1.0f;
     PointLight pointLight;
     DirLight dirLight;
+    float lodBias = 0.0f;
+    size_t trianglesDrawn = 0;
+    CullingStats culling;
+    bool occlusionCulling = true;
+    OcclusionStats occlusion;
+    bool multiDrawIndirect = true;  // only has an effect on GL 4.3 contexts
+    RenderQueueStats renderQueue;
+    int tumbleweeds = 1000;
+    CullingStats tumbleweedCulling;
+    bool pickRequested = false;
+    double pickX = 0.0, pickY = 0.0;
+    std::string picked = "nothing";
+    float pickedDistance = 0.0f;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -111,13 +142,14 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, const ModelLoader &modelLoader);
 
 int main() {
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // a 4.3 context enables the multi draw indirect path of the render queue, 3.3 is the fallback
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -128,6 +160,11 @@ int main() {
     // glfw window creation
     // --------------------
     GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Fallout", NULL, NULL);
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Fallout", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -137,6 +174,7 @@ int main() {
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetKeyCallback(window, key_callback);
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -147,9 +185,12 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    const GLFeatures &features = detectGLFeatures((GLADloadproc) glfwGetProcAddress);
 
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    // once the pack_resources target has run, shaders, models and textures come out of the archive it writes,
+    // mounted before anything is loaded. without it everything is read from resources/ as before
+    if (VirtualFileSystem::shared().mount(FileSystem::getPath("resources.pak")))
+        std::cout << "VFS::MOUNT:: resources.pak" << std::endl;
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -181,41 +222,204 @@ int main() {
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader zastava("resources/shaders/Zastava.vs","resources/shaders/Zastava.fs");
-    Shader blending("resources/shaders/blending.vs", "resources/shaders/blending.fs");
+    // the stones and the tumbleweed field are drawn instanced, these read the transform of each instance
+    Shader ourInstancedShader("resources/shaders/2.model_lighting_instanced.vs", "resources/shaders/2.model_lighting.fs");
+    Shader blending("resources/shaders/blending_instanced.vs", "resources/shaders/blending.fs");
+    // camera and lights reach all the programs through one uniform buffer, written once per frame
+    FrameUniformBuffer frameUniforms;
+    for (const Shader *shader : {&ourShader, &ourInstancedShader, &skyboxShader, &zastava, &blending})
+        frameUniforms.attach(*shader);
+    // ourShader with the per draw uniforms read from the render queue's draw data, for multi draw indirect
+    unique_ptr<Shader> ourIndirectShader;
+    if (features.multiDrawIndirect)
+    {
+        ourIndirectShader.reset(new Shader("resources/shaders/2.model_lighting_indirect.vs", "resources/shaders/2.model_lighting.fs"));
+        frameUniforms.attach(*ourIndirectShader);
+    }
     // load models
     // -----------
-    Model ourModel("resources/objects/tree/scene.gltf");
+    // models are imported on worker threads and show up in the scene as soon as their upload has run in the render loop
+    ModelLoader modelLoader;
+
+    Model ourModel;
     ourModel.SetShaderTextureNamePrefix("material.");
+    ourModel.SetShaderAttributes(ourShader);
+    // the trees, the ground and the ranger are occluders, rasterized on the CPU from their triangles
+    ourModel.SetKeepCpuData(true);
+    modelLoader.load(ourModel, "resources/objects/tree/scene.gltf");
 
-    Model drvo2("resources/objects/old_tree/scene.gltf");
+    Model drvo2;
     drvo2.SetShaderTextureNamePrefix("material.");
+    drvo2.SetShaderAttributes(ourShader);
+    drvo2.SetKeepCpuData(true);
+    modelLoader.load(drvo2, "resources/objects/old_tree/scene.gltf");
 
-    Model zemlja2("resources/objects/ground/scene.gltf");
+    Model zemlja2;
     zemlja2.SetShaderTextureNamePrefix("material.");
+    zemlja2.SetShaderAttributes(ourShader);
+    // the camera also collides with the ground
+    zemlja2.SetKeepCpuData(true);
+    modelLoader.load(zemlja2, "resources/objects/ground/scene.gltf");
 
-    Model lobanja("resources/objects/fox_skull_obj/Fox skull OBJ/fox_skull.obj");
+    Model lobanja;
     lobanja.SetShaderTextureNamePrefix("material.");
+    lobanja.SetShaderAttributes(ourShader);
+    modelLoader.load(lobanja, "resources/objects/fox_skull_obj/Fox skull OBJ/fox_skull.obj");
 
-    Model vatra("resources/objects/smoldering_logs_red_light_bonfire_l/scene.gltf");
+    Model vatra;
     vatra.SetShaderTextureNamePrefix("material.");
+    vatra.SetShaderAttributes(ourShader);
+    modelLoader.load(vatra, "resources/objects/smoldering_logs_red_light_bonfire_l/scene.gltf");
 
-    Model zbun("resources/objects/tumbleweed/scene.gltf");
+    Model zbun;
     zbun.SetShaderTextureNamePrefix("material.");
+    zbun.SetShaderAttributes(ourShader);
+    modelLoader.load(zbun, "resources/objects/tumbleweed/scene.gltf");
 
-    Model ranger("resources/objects/ncr_veteran_ranger_fallout_4/scene.gltf");
+    Model ranger;
     ranger.SetShaderTextureNamePrefix("material.");
-
-    Model cep("resources/objects/nuka_cola_bottle_cap/scene.gltf");
+    ranger.SetShaderAttributes(ourShader);
+    // the big meshes use the 16 byte packed vertices, to save memory and vertex fetch bandwidth,
+    // and triangle strips where those come out smaller than the triangle list
+    ranger.SetVertexFormat(VERTEX_FORMAT_PACKED);
+    ranger.SetIndexStrips(true);
+    ranger.SetKeepCpuData(true);
+    modelLoader.load(ranger, "resources/objects/ncr_veteran_ranger_fallout_4/scene.gltf");
+
+    Model cep;
     cep.SetShaderTextureNamePrefix("material.");
+    cep.SetShaderAttributes(ourShader);
+    modelLoader.load(cep, "resources/objects/nuka_cola_bottle_cap/scene.gltf");
 
-    Model Ruksak("resources/objects/backpack (1)/scene.gltf");
+    Model Ruksak;
     Ruksak.SetShaderTextureNamePrefix("material.");
+    Ruksak.SetShaderAttributes(ourShader);
+    modelLoader.load(Ruksak, "resources/objects/backpack (1)/scene.gltf");
 
-    Model bobblehead("resources/objects/ncr_veteran_ranger_bobblehead/scene.gltf");
+    Model bobblehead;
     bobblehead.SetShaderTextureNamePrefix("material.");
+    bobblehead.SetShaderAttributes(ourShader);
+    // a dozen small materials, packed into texture arrays so the whole bobblehead draws with one texture bind
+    bobblehead.SetTextureArrays(true);
+    modelLoader.load(bobblehead, "resources/objects/ncr_veteran_ranger_bobblehead/scene.gltf");
 
-    Model pipBoy("resources/objects/retro-modernized_pip_boy_editable_screen/scene.gltf");
+    Model pipBoy;
     pipBoy.SetShaderTextureNamePrefix("material.");
+    pipBoy.SetShaderAttributes(ourShader);
+    pipBoy.SetVertexFormat(VERTEX_FORMAT_PACKED);
+    pipBoy.SetIndexStrips(true);
+    modelLoader.load(pipBoy, "resources/objects/retro-modernized_pip_boy_editable_screen/scene.gltf");
+
+    // where the models are placed
+    //prvo drvo
+    glm::mat4 modelDrvo = glm::mat4(1.0f);
+    modelDrvo = glm::translate(modelDrvo,
+                           glm::vec3(10.0f, 0.74f, 1.0f)); // translate it down so it's at the center of the scene
+    modelDrvo = glm::rotate(modelDrvo, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
+    modelDrvo = glm::scale(modelDrvo, glm::vec3(2.0f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelRanger = glm::mat4(1.0f);
+    modelRanger = glm::translate(modelRanger,
+                                 glm::vec3(1.0f, 1.06f, -3.0f));
+    modelRanger = glm::rotate(modelRanger, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
+    modelRanger = glm::scale(modelRanger, glm::vec3(0.04f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelCep = glm::mat4(1.0f);
+    modelCep = glm::translate(modelCep,
+                              glm::vec3(3.0f, 1.1f, -2.0f));
+    modelCep = glm::rotate(modelCep, glm::radians(-90.0f), glm::vec3( 1.0f, 0.0f, 0.0f));
+    modelCep = glm::scale(modelCep, glm::vec3(0.005f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelDrvo2 = glm::mat4(1.0f);
+    modelDrvo2 = glm::translate(modelDrvo2,
+                                glm::vec3(-5.0f, 0.4f, 1.0f)); // translate it down so it's at the center of the scene
+     modelDrvo2 = glm::rotate(modelDrvo2, glm::radians(180.0f), glm::vec3(0, 1.0f, 0.0f));
+    modelDrvo2 = glm::scale(modelDrvo2, glm::vec3(1.5f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelZemlja2 = glm::mat4(1.0f);
+    modelZemlja2 = glm::translate(modelZemlja2,
+                                  glm::vec3(1.0f, -.0f, 1.0f)); // translate it down so it's at the center of the scene
+    modelZemlja2 = glm::rotate(modelZemlja2, glm::radians(-90.0f), glm::vec3(1.0f,  0.0f, 0));
+    modelZemlja2 = glm::scale(modelZemlja2, glm::vec3(0.55f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelLobanja = glm::mat4(1.0f);
+    modelLobanja = glm::translate(modelLobanja,
+                                  glm::vec3(1.0f, 0.85f, 1.0f)); // translate it down so it's at the center of the scene
+    // modelLobanja = glm::rotate(modelLobanja, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
+    modelLobanja = glm::scale(modelLobanja, glm::vec3(0.012f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelvatra = glm::mat4(1.0f);
+    modelvatra = glm::translate(modelvatra,
+                                glm::vec3(1.0f, 0.72f, 3.0f)); // translate it down so it's at the center of the scene
+    // modelvatra = glm::rotate(modelvatra, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
+    modelvatra = glm::scale(modelvatra, glm::vec3(1.5f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelZbun = glm::mat4(1.0f);
+    modelZbun = glm::translate(modelZbun,
+                               glm::vec3(1.0f, 1.84f, -7.0f)); // translate it down so it's at the center of the scene
+    // modelZbun = glm::rotate(modelZbun, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
+    modelZbun = glm::scale(modelZbun, glm::vec3(0.17f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelRuksak = glm::mat4(1.0f);
+    modelRuksak = glm::translate(modelRuksak,
+                              glm::vec3(-1.2f, 1.0f, 4.0f));
+    modelRuksak = glm::rotate(modelRuksak, glm::radians(150.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
+    modelRuksak = glm::scale(modelRuksak, glm::vec3(0.01f));
+
+    glm::mat4 modelBoblehead = glm::mat4(1.0f);
+    modelBoblehead = glm::translate(modelBoblehead,
+                              glm::vec3(-1.2f, 1.0f, 4.3f));
+    modelBoblehead = glm::rotate(modelBoblehead, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
+    modelBoblehead = glm::scale(modelBoblehead, glm::vec3(0.005f));    // it's a bit too big for our scene, so scale it down
+
+    glm::mat4 modelPipBoy = glm::mat4(1.0f);
+    modelPipBoy = glm::translate(modelPipBoy,
+                                    glm::vec3(-0.5f, 0.67f, 5.0f));
+    //modelPipBoy = glm::rotate(modelPipBoy, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
+    modelPipBoy = glm::scale(modelPipBoy, glm::vec3(0.2f));    // it's a bit too big for our scene, so scale it down
+
+    // the placements are the local transforms of the scene graph's nodes, the backpack hangs from an offset node the
+    // ImGui controls move. the scene BVH culls, picks and collides the models where the graph puts them, the camera
+    // can't walk through the ground
+    SceneGraph sceneGraph;
+    SceneBvh scene;
+    OcclusionBuffer occlusion;
+    RenderQueue renderQueue;
+    if (ourIndirectShader)
+        renderQueue.setIndirectProgram(ourShader, *ourIndirectShader);
+    // a model placed in the scene, dirLightSign is -1 for the models that are lit from the opposite direction
+    struct SceneModel {
+        Model *model;
+        int node;
+        int object;
+        float dirLightSign;
+    };
+    vector<SceneModel> sceneModels;
+    vector<int> nodeObjects;  // scene BVH object of each graph node, -1 for nodes without a model
+    auto place = [&](const string &name, Model &model, const glm::mat4 &local, float dirLightSign, unsigned int flags = 0,
+                     int parent = SCENE_NO_PARENT) {
+        int node = sceneGraph.add(local, parent, name);
+        sceneGraph.update();
+        int object = scene.add(name, model, sceneGraph.world(node), flags);
+        nodeObjects.resize(sceneGraph.size(), -1);
+        nodeObjects[node] = object;
+        sceneModels.push_back(SceneModel{&model, node, object, dirLightSign});
+        return object;
+    };
+    place("tree", ourModel, modelDrvo, 1.0f, SCENE_OCCLUDER);
+    place("ranger", ranger, modelRanger, 1.0f, SCENE_OCCLUDER);
+    place("bottle cap", cep, modelCep, 1.0f);
+    place("old tree", drvo2, modelDrvo2, -1.0f, SCENE_OCCLUDER);
+    int zemlja2Object = place("ground", zemlja2, modelZemlja2, -1.0f, SCENE_COLLISION | SCENE_OCCLUDER);
+    place("fox skull", lobanja, modelLobanja, -1.0f);
+    place("bonfire", vatra, modelvatra, -1.0f);
+    place("tumbleweed", zbun, modelZbun, -1.0f);
+    int backpackOffset = sceneGraph.add(glm::mat4(1.0f), SCENE_NO_PARENT, "backpack offset");
+    place("backpack", Ruksak, modelRuksak, -1.0f, 0, backpackOffset);
+    int backpackNode = sceneGraph.find("backpack");
+    place("bobblehead", bobblehead, modelBoblehead, -1.0f);
+    place("Pip-Boy", pipBoy, modelPipBoy, -1.0f);
+    programState->camera.Collider = &scene;
 
     float flagVertices[] = {
             //      vertex           texture        normal
@@ -339,8 +543,21 @@ int main() {
 
     zastava.use();
     zastava.setInt("texture1", 0);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    zastava.setFloat("shininess", 64.0f);
+
+    setMaterialSamplers(ourShader, "material.");
+    ourShader.setFloat("material.shininess", 32.0f);
+    setMaterialSamplers(ourInstancedShader, "material.");
+    ourInstancedShader.setFloat("material.shininess", 32.0f);
+    if (ourIndirectShader)
+    {
+        setMaterialSamplers(*ourIndirectShader, "material.");
+        ourIndirectShader->setFloat("material.shininess", 32.0f);
+    }
+
+    blending.use();
+    blending.setInt("texture1", 0);
+    blending.setFloat("shininess", 32.0f);
 
 
     float stoneVertices[] = {
@@ -379,9 +596,23 @@ int main() {
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
     glBindVertexArray(0);
 
-    stbi_set_flip_vertically_on_load(false);
-    unsigned int bushTexture = loadTexture("resources/textures/pngwing.com.png");
-    stbi_set_flip_vertically_on_load(true);
+    unsigned int bushTexture = loadTexture("resources/textures/pngwing.com.png", false);
+
+    // the stones are one instanced draw, their transforms are uploaded back to front every frame
+    vector<glm::mat4> stoneTransforms;
+    for (const glm::vec3 &position : stonePosition) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(0, 1, 0));
+        model = glm::translate(model, position);
+        model = glm::scale(model, glm::vec3(0.8f));
+        stoneTransforms.push_back(model);
+    }
+    InstanceBuffer stoneInstances;
+
+    // the tumbleweed field is scattered once the ground and the tumbleweed are loaded, programState->tumbleweeds
+    // of them are drawn
+    vector<glm::mat4> tumbleweedField;
+    ModelInstances tumbleweeds(zbun);
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -404,209 +635,160 @@ int main() {
         // -----
         processInput(window);
 
+        // upload models and textures that finished loading in the background
+        modelLoader.processUploads();
+        TextureStreamer::shared().processUploads();
+        TextureRegistry::shared().collectGarbage();
+        // only the nodes that moved (and what hangs from them) get new world transforms, and only their objects
+        // are refitted in the scene BVH
+        sceneGraph.setLocal(backpackOffset, glm::translate(glm::mat4(1.0f), programState->backpackPosition));
+        sceneGraph.setLocal(backpackNode, glm::scale(modelRuksak, glm::vec3(programState->backpackScale)));
+        sceneGraph.update();
+        for (int node : sceneGraph.changed())
+            if (nodeObjects[node] >= 0)
+                scene.setTransform(nodeObjects[node], sceneGraph.world(node));
+        // picks up the bounds and collision triangles of models that just finished loading
+        scene.update();
+
+        // drop the tumbleweeds onto the ground's triangles at random spots, the ones that would land on
+        // something else (a tree, the bonfire) are skipped
+        if (tumbleweedField.empty() && zemlja2.isLoaded() && zbun.isLoaded())
+        {
+            mt19937 random(7);
+            uniform_real_distribution<float> unit(0.0f, 1.0f);
+            float bottom = modelBounds(zbun).min.y;
+            for (int attempt = 0; attempt < MAX_TUMBLEWEEDS * 4 && (int)tumbleweedField.size() < MAX_TUMBLEWEEDS; attempt++)
+            {
+                float angle = unit(random) * glm::radians(360.0f), radius = sqrt(unit(random)) * 11.0f;
+                float yaw = unit(random) * glm::radians(360.0f), scale = 0.17f * (0.7f + 0.6f * unit(random));
+                glm::vec3 origin(1.0f + cos(angle) * radius, 20.0f, 1.0f + sin(angle) * radius);
+                float distance;
+                if (scene.pick(origin, glm::vec3(0.0f, -1.0f, 0.0f), distance) != zemlja2Object)
+                    continue;
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), origin - glm::vec3(0.0f, distance + bottom * scale, 0.0f));
+                model = glm::rotate(model, yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scale));
+                tumbleweedField.push_back(model);
+            }
+        }
+        size_t tumbleweedCount = min((size_t)programState->tumbleweeds, tumbleweedField.size());
+        if (tumbleweeds.transforms().size() != tumbleweedCount)
+            tumbleweeds.setTransforms(vector<glm::mat4>(tumbleweedField.begin(), tumbleweedField.begin() + tumbleweedCount));
+
 
         // render
         // ------
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        zastava.use();
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        zastava.setMat4("view", view);
-        zastava.setMat4("projection", projection);
-
-        glBindVertexArray(flagVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, flagTexture);
-        model = glm::translate(model, glm::vec3(0.0f, -5.0f, 0.0f));
-       //model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
-        zastava.setMat4("model", model);
 
+        // camera and lights for every program, the draws themselves go through the render queue
+        pointLight.position = glm::vec3(1.0 , 0.72f, 3.0 );
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewPosition = glm::vec4(programState->camera.Position, 1.0f);
+        frame.dirLightDirection = glm::vec4(dirLight.direction, 0.0f);
+        frame.dirLightAmbient = glm::vec4(dirLight.ambient, 0.0f);
+        frame.dirLightDiffuse = glm::vec4(dirLight.diffuse, 0.0f);
+        frame.dirLightSpecular = glm::vec4(dirLight.specular, 0.0f);
+        frame.pointLightPosition = glm::vec4(pointLight.position, 1.0f);
+        frame.pointLightAmbient = glm::vec4(pointLight.ambient, 0.0f);
+        frame.pointLightDiffuse = glm::vec4(pointLight.diffuse, 0.0f);
+        frame.pointLightSpecular = pointLight.specular;
+        frame.pointLightConstant = pointLight.constant;
+        frame.pointLightLinear = pointLight.linear;
+        frame.pointLightQuadratic = pointLight.quadratic;
+        frameUniforms.update(frame);
+
+        // meshes outside the view are skipped, the rest pick their level of detail from their size on screen
+        glm::mat4 projectionView = projection * view;
+        CullingStats culling;
+        LodContext lod = LodContext::perspective(programState->camera.Position, glm::radians(programState->camera.Zoom),
+                                                 (float)SCR_HEIGHT, programState->lodBias);
+        size_t trianglesDrawn = 0;
+
+        // pick the object under the cursor, the click is turned into a world space ray through the inverse projection
+        if (programState->pickRequested)
+        {
+            programState->pickRequested = false;
+            int width, height;
+            glfwGetWindowSize(window, &width, &height);
+            glm::vec2 ndc(2.0f * (float)programState->pickX / width - 1.0f, 1.0f - 2.0f * (float)programState->pickY / height);
+            glm::mat4 inverseProjectionView = glm::inverse(projectionView);
+            glm::vec4 nearPoint = inverseProjectionView * glm::vec4(ndc.x, ndc.y, -1.0f, 1.0f);
+            glm::vec4 farPoint = inverseProjectionView * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f);
+            glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+            glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+            float distance;
+            int picked = scene.pick(origin, direction, distance);
+            programState->picked = picked < 0 ? "nothing" : scene.name(picked);
+            programState->pickedDistance = picked < 0 ? 0.0f : distance;
+        }
 
-        zastava.setVec3("dirLight.direction", dirLight.direction);
-        zastava.setVec3("dirLight.ambient", dirLight.ambient);
-        zastava.setVec3("dirLight.diffuse", dirLight.diffuse);
-        zastava.setVec3("dirLight.specular", dirLight.specular);
-        zastava.setFloat("shininess", 64.0f);
+        // everything is queued and sorted: opaque draws by state then front to back, the sky, then the
+        // blended stones back to front
+        renderQueue.begin(programState->camera.Position, 100.0f);
 
+        glm::mat4 flagModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -5.0f, 0.0f));
+        //flagModel = glm::rotate(flagModel, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
+        renderQueue.submitArrays(zastava, renderQueue.addObject(flagModel), flagVAO, GL_TEXTURE_2D, flagTexture,
+                                 GL_TRIANGLES, 0, 6, glm::vec3(flagModel * glm::vec4(0.0f, -20.0f, 0.0f, 1.0f)));
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
+        // render the loaded models, the scene BVH skips the ones that are out of view or hidden by the occluders as a whole
+        scene.cull(projectionView, programState->occlusionCulling ? &occlusion : nullptr);
+        programState->occlusion = programState->occlusionCulling ? occlusion.lastStats() : OcclusionStats();
+        for (const SceneModel &placed : sceneModels)
+        {
+            Model &model = *placed.model;
+            if (!scene.isVisible(placed.object))
+            {
+                culling.culled += model.meshes.size();
+                continue;
+            }
+            const glm::mat4 &transform = sceneGraph.world(placed.node);
+            model.Cull(projectionView, transform, culling);
+            trianglesDrawn += model.SelectLod(transform, lod);
+            unsigned int queued = renderQueue.addObject(transform, glm::vec4(placed.dirLightSign, 0.0f, 0.0f, 0.0f));
+            renderQueue.submit(model, ourShader, queued);
+        }
 
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-        ourShader.setVec3("dirLight.direction", dirLight.direction);
-        ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-        ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-        ourShader.setVec3("dirLight.specular", dirLight.specular);
-        ourShader.setFloat("shininess", 32.0f);
+        // the whole field is culled and picks its levels of detail per instance, then goes out as a draw per level
+        CullingStats tumbleweedCulling;
+        trianglesDrawn += tumbleweeds.update(projectionView, glm::mat4(1.0f), lod, tumbleweedCulling);
+        renderQueue.submitInstances(tumbleweeds, ourInstancedShader, renderQueue.addObject(glm::mat4(1.0f), glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f)));
+        programState->trianglesDrawn = trianglesDrawn;
+        programState->culling = culling;
+        programState->tumbleweedCulling = tumbleweedCulling;
+
+        auto stoneCenter = [](const glm::mat4 &model) { return glm::vec3(model * glm::vec4(0.5f, 0.0f, 0.0f, 1.0f)); };
+        std::sort(stoneTransforms.begin(), stoneTransforms.end(), [&](const glm::mat4 &a, const glm::mat4 &b) {
+            return glm::length(stoneCenter(a) - programState->camera.Position) > glm::length(stoneCenter(b) - programState->camera.Position);
+        });
+        stoneInstances.update(stoneTransforms);
+        renderQueue.submitArraysInstanced(blending, renderQueue.addObject(glm::mat4(1.0f)), stoneVAO, GL_TEXTURE_2D, bushTexture,
+                                          GL_TRIANGLES, 0, 6, stoneInstances, 0, stoneTransforms.size(),
+                                          stoneCenter(stoneTransforms[0]), RENDER_PASS_TRANSPARENT, 0);
 
-        pointLight.position = glm::vec3(1.0 , 0.72f, 3.0 );
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        // view/projection transformations
-        glm::mat4 projection1 = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view1 = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        // skybox cube
+        renderQueue.submitArrays(skyboxShader, RENDER_NO_OBJECT, skyBoxVAO, GL_TEXTURE_CUBE_MAP, cubemapTexture, GL_TRIANGLES,
+                                 0, 36, programState->camera.Position, RENDER_PASS_SKY);
 
         glDepthFunc(GL_LEQUAL);
-
         //Face culling
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
-
-        // render the loaded model
-        //prvo drvo
-        glm::mat4 modelDrvo = glm::mat4(1.0f);
-        modelDrvo = glm::translate(modelDrvo,
-                               glm::vec3(10.0f, 0.74f, 1.0f)); // translate it down so it's at the center of the scene
-        modelDrvo = glm::rotate(modelDrvo, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
-        modelDrvo = glm::scale(modelDrvo, glm::vec3(2.0f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelDrvo);
-        ourModel.Draw(ourShader);
-
-        glm::mat4 modelRanger = glm::mat4(1.0f);
-        modelRanger = glm::translate(modelRanger,
-                                     glm::vec3(1.0f, 1.06f, -3.0f));
-        modelRanger = glm::rotate(modelRanger, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
-        modelRanger = glm::scale(modelRanger, glm::vec3(0.04f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelRanger);
-        ranger.Draw(ourShader);
-
-        glm::mat4 modelCep = glm::mat4(1.0f);
-        modelCep = glm::translate(modelCep,
-                                  glm::vec3(3.0f, 1.1f, -2.0f));
-        modelCep = glm::rotate(modelCep, glm::radians(-90.0f), glm::vec3( 1.0f, 0.0f, 0.0f));
-        modelCep = glm::scale(modelCep, glm::vec3(0.005f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelCep);
-        cep.Draw(ourShader);
-
-        glm::mat4 modelDrvo2 = glm::mat4(1.0f);
-        modelDrvo2 = glm::translate(modelDrvo2,
-                                    glm::vec3(-5.0f, 0.4f, 1.0f)); // translate it down so it's at the center of the scene
-         modelDrvo2 = glm::rotate(modelDrvo2, glm::radians(180.0f), glm::vec3(0, 1.0f, 0.0f));
-        modelDrvo2 = glm::scale(modelDrvo2, glm::vec3(1.5f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setVec3("dirLight.direction", -1.0f*dirLight.direction);
-        ourShader.setMat4("model", modelDrvo2);
-        drvo2.Draw(ourShader);
-
-        glm::mat4 modelZemlja2 = glm::mat4(1.0f);
-        modelZemlja2 = glm::translate(modelZemlja2,
-                                      glm::vec3(1.0f, -.0f, 1.0f)); // translate it down so it's at the center of the scene
-        modelZemlja2 = glm::rotate(modelZemlja2, glm::radians(-90.0f), glm::vec3(1.0f,  0.0f, 0));
-        modelZemlja2 = glm::scale(modelZemlja2, glm::vec3(0.55f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelZemlja2);
-        zemlja2.Draw(ourShader);
-
-        glm::mat4 modelLobanja = glm::mat4(1.0f);
-        modelLobanja = glm::translate(modelLobanja,
-                                      glm::vec3(1.0f, 0.85f, 1.0f)); // translate it down so it's at the center of the scene
-        // modelLobanja = glm::rotate(modelLobanja, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
-        modelLobanja = glm::scale(modelLobanja, glm::vec3(0.012f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelLobanja);
-        lobanja.Draw(ourShader);
-
-        glm::mat4 modelvatra = glm::mat4(1.0f);
-        modelvatra = glm::translate(modelvatra,
-                                    glm::vec3(1.0f, 0.72f, 3.0f)); // translate it down so it's at the center of the scene
-        // modelvatra = glm::rotate(modelvatra, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
-        modelvatra = glm::scale(modelvatra, glm::vec3(1.5f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelvatra);
-        vatra.Draw(ourShader);
-
-        glm::mat4 modelZbun = glm::mat4(1.0f);
-        modelZbun = glm::translate(modelZbun,
-                                   glm::vec3(1.0f, 1.84f, -7.0f)); // translate it down so it's at the center of the scene
-        // modelZbun = glm::rotate(modelZbun, glm::radians(90.0f), glm::vec3(0, 0.0f, 1.0f));
-        modelZbun = glm::scale(modelZbun, glm::vec3(0.17f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelZbun);
-        zbun.Draw(ourShader);
-
-
-
-        glm::mat4 modelRuksak = glm::mat4(1.0f);
-        modelRuksak = glm::translate(modelRuksak,
-                                  glm::vec3(-1.2f, 1.0f, 4.0f));
-        modelRuksak = glm::rotate(modelRuksak, glm::radians(150.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
-        modelRuksak = glm::scale(modelRuksak, glm::vec3(0.01f));
-        ourShader.setVec3("dirLight.direction", -1.0f*dirLight.direction);// it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelRuksak);
-        Ruksak.Draw(ourShader);
-
-        glm::mat4 modelBoblehead = glm::mat4(1.0f);
-        modelBoblehead = glm::translate(modelBoblehead,
-                                  glm::vec3(-1.2f, 1.0f, 4.3f));
-        modelBoblehead = glm::rotate(modelBoblehead, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
-        modelBoblehead = glm::scale(modelBoblehead, glm::vec3(0.005f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelBoblehead);
-        bobblehead.Draw(ourShader);
-
-        glm::mat4 modelPipBoy = glm::mat4(1.0f);
-        modelPipBoy = glm::translate(modelPipBoy,
-                                        glm::vec3(-0.5f, 0.67f, 5.0f));
-        //modelPipBoy = glm::rotate(modelPipBoy, glm::radians(-30.0f), glm::vec3( 0.0f, 1.0f, 0.0f));
-        modelPipBoy = glm::scale(modelPipBoy, glm::vec3(0.2f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", modelPipBoy);
-        pipBoy.Draw(ourShader);
-
-        glDisable(GL_CULL_FACE);
-        glBindVertexArray(stoneVAO);
-        glBindTexture(GL_TEXTURE_2D, bushTexture);
-
-        blending.use();
-        blending.setInt("texture1", 0);
-        blending.setMat4("projection", projection);
-        blending.setMat4("view", view);
-
-        blending.setVec3("dirLight.direction", dirLight.direction);
-        blending.setVec3("dirLight.ambient", dirLight.ambient);
-        blending.setVec3("dirLight.diffuse", dirLight.diffuse);
-        blending.setVec3("dirLight.specular", dirLight.specular);
-        blending.setFloat("shininess", 32.0f);
-
-        for(int i = 0; i < 3; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::rotate(model, glm::radians(-60.0f), glm::vec3(0, 1, 0));
-            model = glm::translate(model, stonePosition[i]);
-            model = glm::scale(model, glm::vec3(0.8f));
-            blending.use();
-            blending.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-        }
-        glEnable(GL_CULL_FACE);
-
-
-        // skybox cube
-
-        skyboxShader.use();
-        view[3][0] = 0;
-        view[3][1] = 0;
-        view[3][2] = 0;
-        view[3][3] = 0;
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-
-        glBindVertexArray(skyBoxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        renderQueue.sort();
+        renderQueue.setMultiDrawIndirect(programState->multiDrawIndirect);
+        renderQueue.execute();
+        programState->renderQueue = renderQueue.lastStats();
         glDepthFunc(GL_LESS); // set depth function back to default
 
 
         if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+            DrawImGui(programState, modelLoader);
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -675,71 +857,25 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-unsigned int loadTexture(char const *path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    // with the cursor free (ImGui on) a left click picks whatever is under it, unless ImGui wants the click
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && programState->ImGuiEnabled &&
+        !ImGui::GetIO().WantCaptureMouse) {
+        glfwGetCursorPos(window, &programState->pickX, &programState->pickY);
+        programState->pickRequested = true;
     }
+}
 
-    return textureID;
+unsigned int loadTexture(char const *path, bool flipVertically) {
+    return TextureRegistry::shared().load(path, flipVertically);
 }
 
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::shared().loadCubemap(faces, true);
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, const ModelLoader &modelLoader) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -757,6 +893,22 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+        ImGui::SliderFloat("LOD bias", &programState->lodBias, -2.0f, 4.0f);
+        ImGui::Text("Model triangles drawn: %zu", programState->trianglesDrawn);
+        ImGui::Text("Meshes submitted: %zu, culled: %zu", programState->culling.submitted, programState->culling.culled);
+        ImGui::SliderInt("Tumbleweeds", &programState->tumbleweeds, 0, MAX_TUMBLEWEEDS);
+        ImGui::Text("Tumbleweeds drawn: %zu, culled: %zu", programState->tumbleweedCulling.submitted,
+                    programState->tumbleweedCulling.culled);
+        ImGui::Checkbox("Occlusion culling", &programState->occlusionCulling);
+        ImGui::Text("Occluded models: %zu / %zu, %zu occluder triangles in %.2f ms", programState->occlusion.occluded,
+                    programState->occlusion.tested, programState->occlusion.occluderTriangles, programState->occlusion.milliseconds);
+        if (glFeatures().multiDrawIndirect)
+            ImGui::Checkbox("Multi draw indirect", &programState->multiDrawIndirect);
+        ImGui::Text("Draws: %zu (%zu instances) in %zu draw calls, program changes: %zu, VAO changes: %zu, material changes: %zu",
+                    programState->renderQueue.draws, programState->renderQueue.instances, programState->renderQueue.drawCalls,
+                    programState->renderQueue.programChanges,
+                    programState->renderQueue.vertexArrayChanges, programState->renderQueue.materialChanges);
+        ImGui::Text("Picked: %s (%.2f)", programState->picked.c_str(), programState->pickedDistance);
         ImGui::End();
     }
 
@@ -770,6 +922,29 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Loading stats");
+        const ModelLoadStats& stats = modelLoadStats();
+        ImGui::Text("Mesh cache hits: %u / %u (%.0f%%)", stats.cacheHits, stats.cacheHits + stats.cacheMisses, stats.hitRate() * 100.0f);
+        ImGui::Text("Cached model load time: %.1f ms", stats.cacheMilliseconds);
+        ImGui::Text("Imported model load time: %.1f ms", stats.importMilliseconds);
+        ImGui::Text("Archives mounted: %zu", VirtualFileSystem::shared().mounted());
+        if (modelLoader.pending())
+            ImGui::Text("Models loading: %u", modelLoader.pending());
+        else
+            ImGui::Text("All models loaded in %.1f ms", modelLoader.totalMilliseconds());
+        ImGui::Text("Textures streaming: %u", TextureStreamer::shared().pending());
+        ImGui::Text("Textures from cache: %u", TextureStreamer::shared().cacheHits());
+        const TextureRegistry& registry = TextureRegistry::shared();
+        ImGui::Text("Textures: %zu unique, %u reused", registry.size(), registry.reuseCount());
+        ImGui::Text("Texture memory: %.1f MB, %.1f MB saved by sharing",
+                    registry.residentBytes() / (1024.0 * 1024.0), registry.savedBytes() / (1024.0 * 1024.0));
+        const GeometryPool& geometry = GeometryPool::shared();
+        ImGui::Text("Geometry: %zu vertex layouts, %.1f / %.1f MB used",
+                    geometry.layoutCount(), geometry.usedBytes() / (1024.0 * 1024.0), geometry.capacityBytes() / (1024.0 * 1024.0));
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -0,0 +1,110 @@
+// Packs asset directories into an archive the VirtualFileSystem can mount (see include/learnopengl/archive.h).
+//
+//   pack_assets <archive> <directory or file>... [--exclude <path>]... [--store]
+//
+// files are stored under their paths as given (run it from the project root, which is what the pack_resources target
+// does) and packed in path order, so the files of a model end up next to each other in the archive.
+// --store skips the LZ4 compression.
+
+#include <learnopengl/archive.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+static bool excluded(const string &path, const vector<string> &exclude)
+{
+    for (const string &prefix : exclude)
+        if (path == prefix || (path.compare(0, prefix.size(), prefix) == 0 && path[prefix.size()] == '/'))
+            return true;
+    return false;
+}
+
+// regular files under path, recursively
+static void collect(const string &path, const vector<string> &exclude, vector<string> &files)
+{
+    if (excluded(path, exclude))
+        return;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        cout << "ERROR::PACK_ASSETS::NOT_FOUND: " << path << endl;
+        return;
+    }
+    if (S_ISREG(st.st_mode))
+    {
+        files.push_back(path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+        return;
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    vector<string> children;
+    while (dirent *child = readdir(directory))
+    {
+        string name = child->d_name;
+        if (name != "." && name != "..")
+            children.push_back(path + '/' + name);
+    }
+    closedir(directory);
+    sort(children.begin(), children.end());
+    for (const string &child : children)
+        collect(child, exclude, files);
+}
+
+int main(int argc, char **argv)
+{
+    string archivePath;
+    vector<string> roots, exclude;
+    bool compress = true;
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--exclude" && i + 1 < argc)
+            exclude.push_back(normalizeArchivePath(argv[++i]));
+        else if (argument == "--store")
+            compress = false;
+        else if (archivePath.empty())
+            archivePath = argument;
+        else
+            roots.push_back(normalizeArchivePath(argument));
+    }
+    if (archivePath.empty() || roots.empty())
+    {
+        cout << "usage: pack_assets <archive> <directory or file>... [--exclude <path>]... [--store]" << endl;
+        return 1;
+    }
+    // never pack the archive into itself
+    exclude.push_back(normalizeArchivePath(archivePath));
+
+    vector<string> paths;
+    for (const string &root : roots)
+        collect(root, exclude, paths);
+
+    vector<ArchiveInput> files;
+    for (const string &path : paths)
+    {
+        FileView contents = mapFile(path);
+        if (!contents.valid())
+        {
+            cout << "ERROR::PACK_ASSETS::CANNOT_READ: " << path << endl;
+            return 1;
+        }
+        files.push_back(ArchiveInput{path, contents});
+    }
+
+    ArchiveStats stats;
+    if (!writeArchive(archivePath, files, compress, stats))
+        return 1;
+    cout << "packed " << stats.files << " files (" << stats.compressed << " compressed), "
+         << stats.bytes / (1024.0 * 1024.0) << " MB into " << stats.storedBytes / (1024.0 * 1024.0) << " MB: "
+         << archivePath << endl;
+    return 0;
+}